@@ -11,4 +11,5 @@
 #define DEBUG_CAL		0
 #define DEBUG_SX1302	0
 #define DEBUG_FTIME		0
+#define DEBUG_TIMEREF	0
 #endif
\ No newline at end of file
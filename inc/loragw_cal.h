@@ -0,0 +1,89 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Radio image calibration result cache.
+    Keeps, for each radio, the band, device errors and temperature of the last
+    successful image calibration, so that it can be skipped while the band and
+    temperature still match. The cache can be saved by the application and
+    given back on next start.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_CAL_H
+#define _LORAGW_CAL_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types*/
+#include <stdbool.h>    /* boolean type */
+
+#include "loragw_hal.h"
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define CAL_RADIO_SX1261    LGW_RF_CHAIN_NB         /* cache slot of the SX1261, after the SX1250 of each RF chain */
+#define CAL_RADIO_NB        (LGW_RF_CHAIN_NB + 1)
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS ----------------------------------------------------- */
+
+/**
+@brief Check if the last image calibration of a radio can be reused
+@param radio        The radio slot (RF chain, or CAL_RADIO_SX1261)
+@param freq_hz      The frequency the radio is about to be used at
+@param temperature  The current board temperature
+@param applied      true if the calibration must have been run on the radio since the library was loaded,
+                    false if a record given back with cal_cache_set() is enough
+@return true if band and temperature window match a calibration without device error, false otherwise
+*/
+bool cal_cache_match(uint8_t radio, uint32_t freq_hz, float temperature, bool applied);
+
+/**
+@brief Record the result of a successful image calibration
+@param radio        The radio slot (RF chain, or CAL_RADIO_SX1261)
+@param freq_hz      The frequency used for calibration
+@param dev_errors   The device errors reported by the radio after calibration
+@param temperature  The board temperature at calibration
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int cal_cache_store(uint8_t radio, uint32_t freq_hz, uint16_t dev_errors, float temperature);
+
+/**
+@brief Tell the cache that a radio has been reset and lost its image calibration (the record is kept)
+@param radio        The radio slot (RF chain, or CAL_RADIO_SX1261)
+@return N/A
+*/
+void cal_cache_radio_reset(uint8_t radio);
+
+/**
+@brief Serialize the cache for persistent storage by the application
+@param blob         Pointer to the memory where the cache is serialized
+@param max_size     Size of the blob memory
+@param size         Pointer to return the size of the serialized cache
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int cal_cache_get(uint8_t * blob, uint16_t max_size, uint16_t * size);
+
+/**
+@brief Load a cache previously serialized with cal_cache_get()
+@param blob         Pointer to the serialized cache
+@param size         Size of the serialized cache
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int cal_cache_set(const uint8_t * blob, uint16_t size);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
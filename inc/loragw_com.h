@@ -43,6 +43,12 @@ typedef enum com_write_mode_e {
     LGW_COM_WRITE_MODE_UNKNOWN
 } lgw_com_write_mode_t;
 
+typedef struct com_rb_req_s {
+    uint16_t address;   /* address to read from */
+    uint8_t * data;     /* where to store the data read */
+    uint16_t size;      /* number of bytes to read */
+} lgw_com_rb_req_t;
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
@@ -81,6 +87,11 @@ int lgw_com_wb(uint8_t spi_mux_target, uint16_t address, const uint8_t *data, ui
 */
 int lgw_com_rb(uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t size);
 
+/**
+ * Several burst reads in a single exchange with the MCU, executed in the given order
+*/
+int lgw_com_rb_multi(uint8_t spi_mux_target, const lgw_com_rb_req_t * req, uint8_t nb_req);
+
 /**
  *
 */
@@ -45,6 +45,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define LGW_HAL_SUCCESS     0
 #define LGW_HAL_ERROR       -1
 #define LGW_LBT_NOT_ALLOWED 1
+#define LGW_RECONF_NOT_LIVE 2   /* configuration change needs a stop/start of the concentrator */
 
 /* radio-specific parameters */
 #define LGW_XTAL_FREQU      32000000            /* frequency of the RF reference oscillator */
@@ -57,6 +58,12 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define LGW_MULTI_NB        8       /* number of LoRa 'multi SF' chains */
 #define LGW_MULTI_SF_EN     0xFF    /* bitmask to enable/disable SF for multi-sf correlators  (12 11 10 9 8 7 6 5) */
 
+#define LGW_CAL_CACHE_SIZE_MAX  32      /* maximum size of the serialized calibration cache */
+#define LGW_SNAPSHOT_SIZE_MAX   4096    /* maximum size of a configuration snapshot */
+#define LGW_RX_RING_SIZE        256     /* number of packets buffered by the RX thread, power of 2 */
+#define LGW_RX_FILTER_DEVADDR_NB 4      /* number of DevAddr prefixes of the RX filter */
+#define LGW_INSTCNT_ERROR_MAX   1000    /* largest error, in us, of the counter extrapolated from the host clock by lgw_get_instcnt() */
+
 /* values available for the 'modulation' parameters */
 /* NOTE: arbitrary values */
 #define MOD_UNDEFINED   0
@@ -145,6 +152,8 @@ struct lgw_conf_board_s {
     bool            lorawan_public; /*!> Enable ONLY for *public* networks using the LoRa MAC protocol */
     uint8_t         clksrc;         /*!> Index of RF chain which provides clock to concentrator */
     char            com_path[64];   /*!> Path to access the COM device to connect to the SX1302 */
+    bool            no_crc_check;   /*!> Trust the SX1302 payload CRC status, do not compute the CRC again on the host */
+    uint32_t        temperature_interval_ms; /*!> Temperature sampling interval for RSSI compensation, 0 for the default (10s) */
 };
 
 /**
@@ -198,6 +207,25 @@ struct lgw_conf_demod_s {
     uint8_t     multisf_datarate;   /*!> bitmask to enable spreading-factors for correlators (SF12 - SF5) */
 };
 
+/**
+@struct lgw_conf_rx_filter_s
+@brief Configuration structure for the host side RX packet filter, a zero mask accepts everything
+*/
+struct lgw_conf_rx_filter_s {
+    bool        enable;             /*!> enable or disable the filter */
+    bool        drop_crc_bad;       /*!> drop packets with a bad payload CRC */
+    bool        drop_no_crc;        /*!> drop packets without payload CRC */
+    uint16_t    if_chain_mask;      /*!> bitmask of the IF chains to accept packets from */
+    uint8_t     sf_mask;            /*!> bitmask of the LoRa spreading factors to accept (SF12 - SF5) */
+    uint8_t     size_min;           /*!> minimum payload size */
+    uint8_t     size_max;           /*!> maximum payload size, 0 for no limit */
+    uint8_t     mtype_mask;         /*!> bitmask of the LoRaWAN MHDR message types to accept (bit n for MType n) */
+    uint8_t     devaddr_nb;         /*!> number of DevAddr prefixes, 0 to accept any DevAddr */
+    uint32_t    devaddr_value[LGW_RX_FILTER_DEVADDR_NB]; /*!> LoRaWAN data frames accepted when DevAddr & mask == value */
+    uint32_t    devaddr_mask[LGW_RX_FILTER_DEVADDR_NB];  /*!> (a NetID is a DevAddr prefix) */
+    uint32_t    dedup_window_us;    /*!> keep one copy of a frame received several times within this window, 0 to disable */
+};
+
 /**
 @struct lgw_pkt_rx_s
 @brief Structure containing the metadata of a packet that was received and a pointer to the payload
@@ -208,6 +236,7 @@ struct lgw_pkt_rx_s {
     uint8_t     if_chain;       /*!> by which IF chain was packet received */
     uint8_t     status;         /*!> status of the received packet */
     uint32_t    count_us;       /*!> internal concentrator counter for timestamping, 1 microsecond resolution */
+    uint64_t    count_us64;     /*!> same counter on 64 bits, never wraps (count_us is its 32 LSBs) */
     uint8_t     rf_chain;       /*!> through which RF chain the packet was received */
     uint8_t     modem_id;
     uint8_t     modulation;     /*!> modulation used by the packet */
@@ -226,6 +255,158 @@ struct lgw_pkt_rx_s {
     uint32_t    ftime;          /*!> packet fine timestamp (nanoseconds since last PPS) */
 };
 
+/**
+@struct lgw_pkt_rx_view_s
+@brief Structure containing the metadata of a packet that was received and a pointer to the payload in the HAL RX buffer, valid until the next receive call
+*/
+struct lgw_pkt_rx_view_s {
+    uint32_t    freq_hz;        /*!> central frequency of the IF chain */
+    int32_t     freq_offset;
+    uint8_t     if_chain;       /*!> by which IF chain was packet received */
+    uint8_t     status;         /*!> status of the received packet */
+    uint32_t    count_us;       /*!> internal concentrator counter for timestamping, 1 microsecond resolution */
+    uint64_t    count_us64;     /*!> same counter on 64 bits, never wraps (count_us is its 32 LSBs) */
+    uint8_t     rf_chain;       /*!> through which RF chain the packet was received */
+    uint8_t     modem_id;
+    uint8_t     modulation;     /*!> modulation used by the packet */
+    uint8_t     bandwidth;      /*!> modulation bandwidth (LoRa only) */
+    uint32_t    datarate;       /*!> RX datarate of the packet (SF for LoRa) */
+    uint8_t     coderate;       /*!> error-correcting code of the packet (LoRa only) */
+    float       rssic;          /*!> average RSSI of the channel in dB */
+    float       rssis;          /*!> average RSSI of the signal in dB */
+    float       snr;            /*!> average packet SNR, in dB (LoRa only) */
+    float       snr_min;        /*!> minimum packet SNR, in dB (LoRa only) */
+    float       snr_max;        /*!> maximum packet SNR, in dB (LoRa only) */
+    uint16_t    crc;            /*!> CRC that was received in the payload */
+    uint16_t    size;           /*!> payload size in bytes */
+    const uint8_t * payload;    /*!> pointer to the payload, in the HAL RX buffer */
+    bool        ftime_received; /*!> a fine timestamp has been received */
+    uint32_t    ftime;          /*!> packet fine timestamp (nanoseconds since last PPS) */
+};
+
+/**
+@struct lgw_pkt_rx_rec_s
+@brief Compact record of a received packet, sized after its payload, see lgw_receive_compact()
+*/
+struct lgw_pkt_rx_rec_s {
+    uint64_t    count_us64;     /*!> internal concentrator counter on 64 bits, never wraps */
+    uint32_t    count_us;       /*!> internal concentrator counter for timestamping, 1 microsecond resolution */
+    uint32_t    freq_hz;        /*!> central frequency of the IF chain */
+    int32_t     freq_offset;
+    uint32_t    datarate;       /*!> RX datarate of the packet (SF for LoRa) */
+    uint32_t    ftime;          /*!> packet fine timestamp (nanoseconds since last PPS) */
+    float       rssic;          /*!> average RSSI of the channel in dB */
+    float       rssis;          /*!> average RSSI of the signal in dB */
+    float       snr;            /*!> average packet SNR, in dB (LoRa only) */
+    float       snr_min;        /*!> minimum packet SNR, in dB (LoRa only) */
+    float       snr_max;        /*!> maximum packet SNR, in dB (LoRa only) */
+    uint16_t    crc;            /*!> CRC that was received in the payload */
+    uint16_t    size;           /*!> payload size in bytes */
+    uint16_t    rec_size;       /*!> size of the whole record, the next one starts right after */
+    uint8_t     if_chain;       /*!> by which IF chain was packet received */
+    uint8_t     status;         /*!> status of the received packet */
+    uint8_t     rf_chain;       /*!> through which RF chain the packet was received */
+    uint8_t     modem_id;
+    uint8_t     modulation;     /*!> modulation used by the packet */
+    uint8_t     bandwidth;      /*!> modulation bandwidth (LoRa only) */
+    uint8_t     coderate;       /*!> error-correcting code of the packet (LoRa only) */
+    bool        ftime_received; /*!> a fine timestamp has been received */
+    uint8_t     payload[];      /*!> payload, size bytes */
+};
+
+/* Size of the record of a packet with the given payload size, records are kept 8-byte aligned */
+#define LGW_PKT_RX_REC_SIZE(size)   ((uint16_t)((sizeof(struct lgw_pkt_rx_rec_s) + (size) + 7) & ~7u))
+/* Record following the given one in an arena */
+#define LGW_PKT_RX_REC_NEXT(rec)    ((const struct lgw_pkt_rx_rec_s *)((const uint8_t *)(rec) + (rec)->rec_size))
+
+/**
+@struct lgw_pkt_rx_batch_s
+@brief Caller provided columns to receive the metadata of a batch of packets, see lgw_receive_batch()
+
+Each column is an array of max_pkt elements, NULL for the columns not needed.
+*/
+struct lgw_pkt_rx_batch_s {
+    uint8_t     max_pkt;        /*!> number of elements of each column */
+    uint32_t *  freq_hz;
+    int32_t *   freq_offset;
+    uint8_t *   if_chain;
+    uint8_t *   status;
+    uint32_t *  count_us;
+    uint64_t *  count_us64;
+    uint8_t *   rf_chain;
+    uint8_t *   modem_id;
+    uint8_t *   modulation;
+    uint8_t *   bandwidth;
+    uint32_t *  datarate;
+    uint8_t *   coderate;
+    float *     rssic;
+    float *     rssis;
+    float *     snr;
+    float *     snr_min;
+    float *     snr_max;
+    uint16_t *  crc;
+    uint16_t *  size;
+    bool *      ftime_received;
+    uint32_t *  ftime;
+    uint8_t *   payload;        /*!> arena receiving the payloads back to back, NULL if not needed */
+    uint32_t    payload_size;   /*!> size of the payload arena */
+    uint32_t *  payload_offset; /*!> max_pkt + 1 elements: start of each payload in the arena, then the end of the last one */
+};
+
+/**
+@brief Callback given to lgw_receive_cb(), called for each packet received
+@param pkt packet metadata and payload pointer, only valid during the call
+@param arg user argument given to lgw_receive_cb()
+*/
+typedef void (*lgw_rx_cb_t)(const struct lgw_pkt_rx_view_s * pkt, void * arg);
+
+/**
+@struct lgw_rx_buffer_stats_s
+@brief Fill level of the SX1302 RX buffer and errors found in the data fetched from it, since start
+*/
+struct lgw_rx_buffer_stats_s {
+    uint32_t    nb_resync;          /*!> number of times bytes had to be skipped to find a packet */
+    uint32_t    nb_bytes_skipped;   /*!> number of bytes skipped while resynchronizing */
+    uint32_t    nb_truncated;       /*!> number of packets cut by the end of the fetched data */
+    uint32_t    nb_checksum_error;  /*!> number of packets discarded for a bad checksum */
+    uint32_t    nb_poll;            /*!> number of times the RX buffer byte count was read */
+    uint16_t    fill_last;          /*!> RX buffer fill level at the last poll, in bytes */
+    uint16_t    fill_peak;          /*!> highest RX buffer fill level seen at a poll, in bytes */
+    uint32_t    fill_rate;          /*!> RX buffer fill rate averaged over the last polls, in bytes/s */
+    uint32_t    nb_fifo_full;       /*!> number of polls which found the RX buffer full, packets may have been lost */
+    uint32_t    nb_poll_gap;        /*!> number of polls more than a counter wrap apart, packets waiting that long get wrong timestamps */
+    uint32_t    nb_ts_discontinuity;/*!> number of packets timestamped far before the previous one */
+};
+
+/**
+@struct lgw_rx_filter_stats_s
+@brief Number of packets dropped by the RX filter for each reason, since start
+*/
+struct lgw_rx_filter_stats_s {
+    uint32_t    nb_pkt_accepted;    /*!> number of packets which went through the filter */
+    uint32_t    nb_drop_if_chain;   /*!> number of packets received on an IF chain not accepted */
+    uint32_t    nb_drop_crc_bad;    /*!> number of packets with a bad CRC */
+    uint32_t    nb_drop_no_crc;     /*!> number of packets without CRC */
+    uint32_t    nb_drop_datarate;   /*!> number of packets with a spreading factor not accepted */
+    uint32_t    nb_drop_size;       /*!> number of packets with a payload size out of bounds */
+    uint32_t    nb_drop_mtype;      /*!> number of packets with a LoRaWAN message type not accepted */
+    uint32_t    nb_drop_devaddr;    /*!> number of LoRaWAN data frames with a DevAddr not accepted */
+    uint32_t    nb_drop_duplicate;  /*!> number of copies of a frame already received on another IF chain or modem */
+};
+
+/**
+@struct lgw_rx_thread_stats_s
+@brief Counters of the background RX acquisition thread
+*/
+struct lgw_rx_thread_stats_s {
+    uint32_t    nb_poll;            /*!> number of SX1302 polls */
+    uint32_t    nb_poll_error;      /*!> number of polls that failed */
+    uint32_t    nb_pkt_received;    /*!> number of packets put in the ring */
+    uint32_t    nb_pkt_dropped;     /*!> number of packets fetched while the ring was full */
+    uint32_t    nb_ring_full;       /*!> number of polls that found the ring full */
+    uint32_t    ring_peak;          /*!> highest number of packets waiting in the ring */
+};
+
 /**
 @struct lgw_pkt_tx_s
 @brief Structure containing the configuration of a packet to send and a pointer to the payload
@@ -324,6 +505,7 @@ typedef struct lgw_context_s {
     struct lgw_conf_demod_s     demod_cfg;
     struct lgw_conf_rxif_s      lora_service_cfg;                       /* LoRa service channel config parameters */
     struct lgw_conf_rxif_s      fsk_cfg;                                /* FSK channel config parameters */
+    struct lgw_conf_rx_filter_s rx_filter_cfg;                          /* host side RX packet filter */
     /* Misc */
     struct lgw_conf_sx1261_s    sx1261_cfg;
 } lgw_context_t;
@@ -373,6 +555,20 @@ int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s * conf);
 */
 int lgw_demod_setconf(struct lgw_conf_demod_s * conf);
 
+/**
+@brief Configure the host side RX packet filter, it can be changed at any time
+@param conf structure containing the configuration parameters
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+Rejected packets are dropped right after being read from the RX buffer, before
+the CRC check, fine timestamp and RSSI compensation, and are not returned.
+When the same frame (payload and CRC) is received several times within
+dedup_window_us, on different IF chains or modems, the copy with the best SNR
+(then RSSI) among the packets returned by a call is kept. A copy coming after
+the frame was returned by a previous call is dropped.
+*/
+int lgw_rx_filter_setconf(struct lgw_conf_rx_filter_s * conf);
+
 /**
 @brief Connect to the LoRa concentrator, reset it and configure it according to previously set parameters
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
@@ -385,6 +581,83 @@ int lgw_start(void);
 */
 int lgw_stop(void);
 
+/**
+@brief Get a copy of the current configuration context, to be modified and given to lgw_reconfigure()
+@param context pointer to the memory where the context is copied
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_context(lgw_context_t * context);
+
+/**
+@brief Apply a new configuration to the running concentrator, writing only the affected registers
+@param context pointer to the new configuration context
+@return LGW_HAL_SUCCESS if applied, LGW_RECONF_NOT_LIVE if the change needs a restart (RF chain setup, clock source...), LGW_HAL_ERROR else
+
+IF chains, demodulators, LoRa service and FSK channels and the syncword are
+reconfigured without resetting the radios or reloading the firmwares.
+The whole context is checked before the first register write. If a write fails,
+the previous configuration is written back; if that fails too, every following
+call returns LGW_RECONF_NOT_LIVE until the concentrator is started again.
+*/
+int lgw_reconfigure(const lgw_context_t * context);
+
+/**
+@brief Move the center frequency of a running RF chain, with a bounded RX outage
+@param rf_chain the RF chain to retune
+@param freq_hz the new center frequency of the RF chain
+@param outage_us pointer to return the time during which the demodulators were paused
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The demodulators are paused, the radio is taken from the AGC, image calibration
+is run unless the radio was already calibrated for that band at a close
+temperature since start, and reception is resumed
+on the new frequency. IF channels keep their offset relative to the RF chain.
+Retuning the radio providing the clock (clksrc) briefly stops the SX1302
+clock, so the counter may lag by the outage duration.
+*/
+int lgw_retune(uint8_t rf_chain, uint32_t freq_hz, uint32_t * outage_us);
+
+/**
+@brief Get the configuration snapshot captured by the last lgw_start(), to be given to lgw_snapshot_set() on next boot
+@param blob pointer to the memory where the snapshot is copied
+@param max_size size of the blob memory (LGW_SNAPSHOT_SIZE_MAX is always enough)
+@param size pointer to return the size of the snapshot
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_snapshot_get(uint8_t * blob, uint16_t max_size, uint16_t * size);
+
+/**
+@brief Provide a configuration snapshot for the next lgw_start() to restore in one streamed write (must be set before start)
+@param blob pointer to the snapshot returned by lgw_snapshot_get()
+@param size size of the snapshot
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The snapshot is only used if it was captured with the same configuration and
+library version, otherwise lgw_start() ignores it and runs all configuration
+steps.
+*/
+int lgw_snapshot_set(const uint8_t * blob, uint16_t size);
+
+/**
+@brief Get the radio image calibration cache, to be saved and given to lgw_cal_cache_set() on next boot
+@param blob pointer to the memory where the cache is serialized
+@param max_size size of the blob memory (LGW_CAL_CACHE_SIZE_MAX is always enough)
+@param size pointer to return the size of the serialized cache
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_cal_cache_get(uint8_t * blob, uint16_t max_size, uint16_t * size);
+
+/**
+@brief Provide a saved radio image calibration cache (must be set before start)
+@param blob pointer to the cache returned by lgw_cal_cache_get()
+@param size size of the cache
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+lgw_start() skips the SX1250 image calibration check when the band and the
+temperature (10 C window) match a record without device error.
+*/
+int lgw_cal_cache_set(const uint8_t * blob, uint16_t size);
+
 /**
 @brief A non-blocking function that will fetch up to 'max_pkt' packets from the LoRa concentrator FIFO and data buffer
 @param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
@@ -393,6 +666,129 @@ int lgw_stop(void);
 */
 int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data);
 
+/**
+@brief A non-blocking function like lgw_receive(), filling columns of metadata and a payload arena instead of packet structures
+@param batch pointer to the columns to be filled
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+No more than payload_size / 255 packets are fetched, so that their payloads
+always fit in the arena. The RSSI compensation is applied column wise.
+*/
+int lgw_receive_batch(struct lgw_pkt_rx_batch_s * batch);
+
+/**
+@brief A non-blocking function like lgw_receive(), storing the packets as compact records in a caller supplied arena
+@param max_pkt maximum number of packet that must be retrieved
+@param arena 8-byte aligned memory receiving the records back to back, see LGW_PKT_RX_REC_NEXT()
+@param arena_size size of the arena in bytes
+@param arena_used pointer to return the number of bytes of the arena filled
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+A record takes LGW_PKT_RX_REC_SIZE(payload size) bytes. Packets which do not fit
+in the arena are left in the RX buffer for the next call.
+*/
+int lgw_receive_compact(uint8_t max_pkt, uint8_t * arena, uint32_t arena_size, uint32_t * arena_used);
+
+/**
+@brief Convert a compact packet record to the classic packet structure
+@param rec pointer to the record
+@param pkt pointer to the structure to be filled
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_pkt_rx_rec_unpack(const struct lgw_pkt_rx_rec_s * rec, struct lgw_pkt_rx_s * pkt);
+
+/**
+@brief Like lgw_receive(), but polls until at least one packet is received or the timeout expires
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
+@param pkt_data pointer to an array of struct that will receive the packet metadata and payload pointers
+@param timeout_ms maximum time to wait for packets, 0 to poll once
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved (0 on timeout)
+
+The poll interval shrinks to the shortest time on air of the configured
+datarates while packets arrive, and doubles on each empty poll, up to a
+fraction of the recent time between arrivals (100 ms when idle) and not
+longer than the SX1302 RX buffer takes to get half full at its fill rate.
+*/
+int lgw_receive_wait(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, uint32_t timeout_ms);
+
+/**
+@brief A non-blocking function like lgw_receive(), returning the packet payloads in place instead of copying them
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
+@param pkt_view pointer to an array of struct that will receive the packet metadata and payload pointers
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+
+The payload pointers remain valid until the next call to lgw_receive() or
+lgw_receive_view(), or until the concentrator is stopped.
+*/
+int lgw_receive_view(uint8_t max_pkt, struct lgw_pkt_rx_view_s * pkt_view);
+
+/**
+@brief A non-blocking function that will fetch all the packets available in the concentrator and give them one by one to a callback
+@param cb function called for each packet, straight from the fetch buffer
+@param arg user argument passed to the callback
+@return LGW_HAL_ERROR id the operation failed, else the number of packets given to the callback
+*/
+int lgw_receive_cb(lgw_rx_cb_t cb, void * arg);
+
+/**
+@brief Get the RX buffer fill level telemetry and its packet loss indicators (full buffer, framing errors, timestamp discontinuities)
+@param stats pointer to the structure to be filled
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_rx_buffer_stats(struct lgw_rx_buffer_stats_s * stats);
+
+/**
+@brief Get the number of packets dropped by the RX filter, for each reason
+@param stats pointer to the structure to be filled
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_get_rx_filter_stats(struct lgw_rx_filter_stats_s * stats);
+
+/**
+@brief Start a background thread that polls the concentrator and buffers parsed packets in a ring
+@param poll_interval_ms time to sleep between polls when no packet is received
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+While the thread runs, packets are retrieved with lgw_rx_dequeue() instead of
+lgw_receive(), and lgw_retune()/lgw_reconfigure() are refused. Other calls
+are serialized with the thread. lgw_stop() stops the thread.
+*/
+int lgw_rx_thread_start(uint32_t poll_interval_ms);
+
+/**
+@brief Stop the background RX thread, packets left in the ring can still be dequeued
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_rx_thread_stop(void);
+
+/**
+@brief A non-blocking function that will get up to 'max_pkt' packets buffered by the RX thread
+@param max_pkt maximum number of packet that must be retrieved (equal to the size of the array of struct)
+@param pkt_data pointer to an array of struct that will receive the packet metadata and payload
+@return LGW_HAL_ERROR id the operation failed, else the number of packets retrieved
+*/
+int lgw_rx_dequeue(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data);
+
+/**
+@brief Wait until the RX thread has buffered packets, or the timeout expires
+@param timeout_ms maximum time to wait, in milliseconds
+@return LGW_HAL_ERROR id the operation failed, else the number of packets waiting in the ring
+*/
+int lgw_rx_thread_wait(uint32_t timeout_ms);
+
+/**
+@brief Get the file descriptor signaled by the RX thread when packets are buffered, to be polled by the application event loop
+@return the eventfd (read 8 bytes to clear it, then dequeue until empty), -1 if the thread is not running or not on Linux
+*/
+int lgw_rx_thread_eventfd(void);
+
+/**
+@brief Get the counters of the RX thread
+@param stats pointer to the structure to be filled
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+*/
+int lgw_rx_thread_get_stats(struct lgw_rx_thread_stats_s * stats);
+
 /**
 @brief Schedule a packet to be send immediately or after a delay depending on tx_mode
 @param pkt_data structure containing the data and metadata for the packet to send
@@ -444,9 +840,66 @@ int lgw_get_trigcnt(uint32_t * trig_cnt_us);
 @brief Return instateneous value of internal counter
 @param inst_cnt_us pointer to receive timestamp value
 @return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The counter is extrapolated from the host clock, and only read from the
+concentrator when the error could exceed LGW_INSTCNT_ERROR_MAX.
 */
 int lgw_get_instcnt(uint32_t * inst_cnt_us);
 
+/**
+@brief Return instateneous value of internal counter on 64 bits
+@param inst_cnt_us pointer to receive timestamp value
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The 64-bit counter never wraps: its 32 LSBs are the value of lgw_get_instcnt().
+Wraps are counted from the host clock when the counter has not been read for
+longer than a wrap period (about 134 s), so it stays right without polling.
+*/
+int lgw_get_instcnt64(uint64_t * inst_cnt_us);
+
+/**
+@brief Return instateneous value of internal counter on 64 bits, extrapolated from the host clock
+@param max_error_us largest acceptable error, in microseconds
+@param inst_cnt_us pointer to receive timestamp value
+@param error_us pointer to receive the bound of the error on inst_cnt_us, in microseconds
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+The counter rate is fitted against the host monotonic clock on every counter
+read (RX polls included). The counter is read from the concentrator only when
+the estimate error bound is above max_error_us; it is then the duration of
+the read itself.
+*/
+int lgw_get_instcnt_estimate(uint32_t max_error_us, uint64_t * inst_cnt_us, uint32_t * error_us);
+
+/**
+@brief Return value of internal counter when latest event (eg GPS pulse) was captured, on 64 bits
+@param trig_cnt_us pointer to receive timestamp value
+@return LGW_HAL_ERROR id the operation failed, LGW_HAL_SUCCESS else
+
+Only valid if the event was captured less than about 134 s ago.
+*/
+int lgw_get_trigcnt64(uint64_t * trig_cnt_us);
+
+/**
+@brief Convert a time of the 64-bit counter to the count_us of a TIMESTAMPED packet to be sent
+@param time_us TX time, on the 64-bit counter
+@param count_us pointer to receive the value for lgw_pkt_tx_s.count_us
+@return LGW_HAL_ERROR if the time is in the past or too far ahead (2^31 us) to be unambiguous, LGW_HAL_SUCCESS else
+*/
+int lgw_time64_to_count_us(uint64_t time_us, uint32_t * count_us);
+
+/**
+@brief Return the crystal correction factor of the internal counter, tracked from the PPS
+@param xtal_correct pointer to receive the correction factor (true time / counter time)
+@param sigma_ppm pointer to receive the standard deviation of the correction, in ppm
+@return LGW_HAL_ERROR if less than two consistent PPS have been seen, LGW_HAL_SUCCESS else
+
+The correction is filtered over all the PPS latched with the counter reads. It
+is applied to fine timestamps, whose error due to the crystal is then about
+ftime * sigma_ppm / 1e6.
+*/
+int lgw_get_xtal_correct(double * xtal_correct, double * sigma_ppm);
+
 /**
 @brief Return the LoRa concentrator EUI
 @param eui pointer to receive eui
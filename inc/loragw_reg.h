@@ -1478,6 +1478,15 @@ int lgw_reg_wb(uint16_t register_id, uint8_t *data, uint16_t size);
 */
 int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size);
 
+/**
+@brief LoRa concentrator register burst reads, all done in one exchange with the MCU
+@param register_id array of register numbers, one per burst
+@param req array of read requests, data and size to be set by the caller, address is set from register_id
+@param nb_req number of bursts
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_rb_multi(const uint16_t *register_id, lgw_com_rb_req_t *req, uint8_t nb_req);
+
 /**
 @brief LoRa concentrator memory burst write
 @param mem_addr the address of the memory section to write to
@@ -1497,6 +1506,28 @@ int lgw_mem_wb(uint16_t mem_addr, const uint8_t *data, uint16_t size);
 */
 int lgw_mem_rb(uint16_t mem_addr, uint8_t *data, uint16_t size, bool fifo_mode);
 
+/**
+@brief Read back the configuration state of a range of registers into an image
+@param first_id first register (by name) of the range
+@param last_id last register (by name) of the range, included
+@param image pointer to byte array where the image records are appended
+@param max_size size of the image byte array
+@param size [in/out] current size of the image, updated with the appended records
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+
+Only writable and checkable fields are captured: read-only, pulse and
+clear-on-write fields are never part of an image.
+*/
+int lgw_reg_image_read(uint16_t first_id, uint16_t last_id, uint8_t *image, uint16_t max_size, uint16_t *size);
+
+/**
+@brief Write back a register image built with lgw_reg_image_read(), as a stream of bulk requests
+@param image pointer to the image byte array
+@param size size of the image
+@return status of register operation (LGW_REG_SUCCESS/LGW_REG_ERROR)
+*/
+int lgw_reg_image_write(const uint8_t *image, uint16_t size);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
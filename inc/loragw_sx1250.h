@@ -38,8 +38,11 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
+int sx1250_calibrate_band(uint32_t freq_hz);
 int sx1250_calibrate(uint8_t rf_chain, uint32_t freq_hz);
+int sx1250_get_device_errors(uint8_t rf_chain, uint16_t * dev_errors);
 int sx1250_setup(uint8_t rf_chain, uint32_t freq_hz, bool single_input_mode);
+int sx1250_set_rx_freq(uint8_t rf_chain, uint32_t freq_hz, bool calibrate);
 
 int sx1250_reg_w(sx1250_op_code_t op_code, uint8_t *data, uint16_t size, uint8_t rf_chain);
 int sx1250_reg_r(sx1250_op_code_t op_code, uint8_t *data, uint16_t size, uint8_t rf_chain);
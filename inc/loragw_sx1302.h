@@ -40,6 +40,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #define REG_SELECT(rf_chain, a, b) ((rf_chain == 0) ? a : b)
 
+#define SX1302_PKT_FILTERED 1 /* sx1302_parse() return value for a packet dropped by the RX filter */
+
 #define SET_PPM_ON(bw,dr)   (((bw == BW_125KHZ) && ((dr == DR_LORA_SF11) || (dr == DR_LORA_SF12))) || ((bw == BW_250KHZ) && (dr == DR_LORA_SF12)))
 
 /* -------------------------------------------------------------------------- */
@@ -97,6 +99,23 @@ typedef enum {
 */
 int sx1302_init(void);
 
+/**
+@brief Capture the configuration registers set up by lgw_start() into an image
+@param image    pointer to the memory holding the image
+@param max_size size of the image memory
+@param size     pointer to return the size of the image
+@return LGW_REG_SUCCESS if no error, LGW_REG_ERROR otherwise
+*/
+int sx1302_config_snapshot(uint8_t * image, uint16_t max_size, uint16_t * size);
+
+/**
+@brief Initialize sx1302 internal structures and restore its configuration registers from an image, in place of sx1302_init() and the configure functions
+@param image    pointer to the memory holding the image
+@param size     size of the image
+@return LGW_REG_SUCCESS if no error, LGW_REG_ERROR otherwise
+*/
+int sx1302_config_restore(const uint8_t * image, uint16_t size);
+
 /**
 @brief Get the SX1302 unique identifier
 @param eui  pointerto the memory holding the concentrator EUI
@@ -114,6 +133,7 @@ int sx1302_get_model_id(sx1302_model_id_t * model_id);
 /**
 @brief Check AGC & ARB MCUs parity error, and update timestamp counter wraping status
 @brief This function needs to be called regularly (every few seconds) by the upper layer
+@note  The counter is only read when its last read is too old to extrapolate it from the host clock
 @param N/A
 @return LGW_REG_SUCCESS if no error, LGW_REG_ERROR otherwise
 */
@@ -151,9 +171,10 @@ int sx1302_radio_host_ctrl(bool host_ctrl);
 @brief Perform the radio calibration sequence and fill the TX gain LUT with calibration offsets
 @param context_rf_chain The RF chains array from which to get RF chains current configuration
 @param clksrc           The RF chain index which provides the clock source
+@param temperature      The current board temperature, to check the calibration cache
 @return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
 */
-int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc);
+int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc, float temperature);
 
 /**
 @brief Configure the PA and LNA LUTs
@@ -221,6 +242,14 @@ int sx1302_lora_modem_configure(uint32_t radio_freq_hz);
 */
 int sx1302_lora_service_modem_configure(struct lgw_conf_rxif_s * cfg, uint32_t radio_freq_hz);
 
+/**
+@brief Update the frequency to time drift compensation of the LoRa modems after a radio frequency change
+@param radio_freq_hz    The new center frequency of the RF chain 0
+@param service_bw       The bandwidth of the LoRa service channel
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_lora_freq_to_time_configure(uint32_t radio_freq_hz, uint8_t service_bw);
+
 /**
 @brief Configure the FSK modem
 @param cfg  A pointer to the channel configuration
@@ -235,6 +264,13 @@ int sx1302_fsk_configure(struct lgw_conf_rxif_s * cfg);
 */
 int sx1302_modem_enable(void);
 
+/**
+@brief Pause or resume all demodulators, leaving their configuration untouched
+@param enable   false to pause reception, true to resume it
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_rx_enable(bool enable);
+
 /**
 @brief Enable/Disable the GPS to allow PPS trigger and counter sampling
 @param enbale   Set to true to enable, false otherwise
@@ -249,6 +285,23 @@ int sx1302_gps_enable(bool enable);
 */
 uint32_t sx1302_timestamp_counter(bool pps);
 
+/**
+@brief Read the SX1302 timestamp counter and return it on 64 bits, so that it never wraps
+@param pps      Set to true to get the counter latched at the last PPS, false for the instantaneous one
+@param cnt_us   A pointer to store the counter value, in microseconds
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_timestamp_counter64(bool pps, uint64_t * cnt_us);
+
+/**
+@brief Get the SX1302 instantaneous counter on 64 bits, extrapolated from the host clock when accurate enough
+@param max_err_us   Largest acceptable error, the counter is read when the estimate is not that accurate
+@param cnt_us       A pointer to store the counter value, in microseconds
+@param err_us       A pointer to store the bound of the error on cnt_us, in microseconds
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_timestamp_counter_estimate(uint32_t max_err_us, uint64_t * cnt_us, uint32_t * err_us);
+
 /**
 @brief Load firmware to AGC MCU memory
 @param firmware A pointer to the fw binary to be loaded
@@ -256,6 +309,15 @@ uint32_t sx1302_timestamp_counter(bool pps);
 */
 int sx1302_agc_load_firmware(const uint8_t *firmware);
 
+/**
+@brief Check if the given firmware is already in AGC MCU memory, and restart it if so
+@param firmware A pointer to the expected fw binary
+@param version  The expected AGC firmware version
+@param loaded   A pointer to store the result, true if the upload can be skipped
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_agc_firmware_loaded(const uint8_t *firmware, uint8_t version, bool *loaded);
+
 /**
 @brief Read the AGC status register for current status
 @param status A pointer to store the current status returned
@@ -298,6 +360,15 @@ int sx1302_agc_start(uint8_t version, uint8_t ana_gain, uint8_t dec_gain);
 */
 int sx1302_arb_load_firmware(const uint8_t *firmware);
 
+/**
+@brief Check if the given firmware is already in ARB MCU memory, and restart it if so
+@param firmware A pointer to the expected fw binary
+@param version  The expected ARB firmware version
+@param loaded   A pointer to store the result, true if the upload can be skipped
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_arb_firmware_loaded(const uint8_t *firmware, uint8_t version, bool *loaded);
+
 /**
 @brief TODO
 @param TODO
@@ -362,20 +433,59 @@ void sx1302_arb_print_debug_stats(void);
 uint16_t sx1302_lora_payload_crc(const uint8_t * data, uint8_t size);
 
 /**
-@brief Get the number of packets available in rx_buffer and fetch data from ...
-@brief ... the SX1302 if rx_buffer is empty.
+@brief Get the number of packets available in the two rx_buffers and fetch data from ...
+@brief ... the SX1302 into a free rx_buffer while the other one may still hold packets to be parsed.
 @param  nb_pkt A pointer to allocated memory to hold the number of packet fetched
 @return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
 */
 int sx1302_fetch(uint8_t * nb_pkt);
 
+/**
+@brief Same as sx1302_fetch() followed by sx1302_update(), with the RX buffer byte count and the
+@brief timestamp counters read in a single exchange: an empty poll costs one USB round trip
+@brief When the SX1302 RX buffer was more than half full, it is read again into the other rx_buffer
+@param  nb_pkt A pointer to allocated memory to hold the number of packet fetched
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_poll(uint8_t * nb_pkt);
+
+/**
+@brief Get the RX buffer framing error counters
+@param stats        The structure to be filled
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_rx_buffer_stats(struct lgw_rx_buffer_stats_s * stats);
+
+/**
+@brief Get the number of packets dropped by the RX filter
+@param stats        The structure to be filled
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int sx1302_rx_filter_stats(struct lgw_rx_filter_stats_s * stats);
+
+/**
+@brief Derive from the configuration the per IF chain values used by sx1302_parse()
+@param context      Gateway configuration context
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+
+To be called whenever the RF or IF chains configuration changes.
+*/
+int sx1302_parse_setup(const lgw_context_t * context);
+
+/**
+@brief Get the payload size of the next packet sx1302_parse() will return, without parsing it
+@param size         A pointer to store the payload size
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR if there is no packet left
+*/
+int sx1302_parse_peek_size(uint8_t * size);
+
 /**
 @brief Parse and return the next packet available in rx_buffer.
 @param context      Gateway configuration context
-@param p            The structure to get the packet parsed
-@return LGW_REG_SUCCESS if a packet could be parsed, LGW_REG_ERROR otherwise
+@param p            The structure to get the packet parsed, its payload points into rx_buffer
+@return LGW_REG_SUCCESS if a packet could be parsed, SX1302_PKT_FILTERED if it was dropped by the RX filter, LGW_REG_ERROR otherwise
 */
-int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p);
+int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_view_s * p);
 
 /**
 @brief Configure the delay to be applied by the SX1302 for TX to start
@@ -26,6 +26,9 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
+#define RX_BUFFER_SIZE          4096
+#define RX_BUFFER_PKT_NB_MAX    (RX_BUFFER_SIZE / 23) /* packets of 0 byte, head+tail metadata only */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
 
@@ -35,6 +38,9 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /**
 @struct rx_packet_s
 @brief packet structure as contained in the sx1302 RX packet engine
+
+The payload and timestamp metrics are not copied: they point into the
+rx_buffer the packet was popped from, and are valid until the next fetch.
 */
 typedef struct rx_packet_s {
     uint8_t     rxbytenb_modem;
@@ -44,7 +50,7 @@ typedef struct rx_packet_s {
     uint8_t     rx_rate_sf;                 /* LoRa only */
     uint8_t     modem_id;
     int32_t     frequency_offset_error;     /* LoRa only */
-    uint8_t     payload[255];
+    const uint8_t * payload;
     bool        payload_crc_error;
     bool        sync_error;                 /* LoRa only */
     bool        header_error;               /* LoRa only */
@@ -59,20 +65,33 @@ typedef struct rx_packet_s {
     uint32_t    timestamp_cnt;
     uint16_t    rx_crc16_value;             /* LoRa only */
     uint8_t     num_ts_metrics_stored;      /* LoRa only */
-    int8_t      timestamp_avg[255];         /* LoRa only */
-    int8_t      timestamp_stddev[255];      /* LoRa only */
+    const int8_t * timestamp_avg;           /* LoRa only, no stddev as nb_symbols is 0 */
     uint8_t     packet_checksum;
 } rx_packet_t;
 
+/**
+@struct rx_buffer_stats_s
+@brief framing errors counted since the rx_buffer was initialized
+*/
+typedef struct rx_buffer_stats_s {
+    uint32_t nb_resync;         /*!> number of times bytes had to be skipped to find a syncword */
+    uint32_t nb_bytes_skipped;  /*!> number of bytes skipped while resynchronizing */
+    uint32_t nb_truncated;      /*!> number of packets cut by the end of the fetched data */
+    uint32_t nb_checksum_error; /*!> number of packets with a bad checksum */
+} rx_buffer_stats_t;
+
 /**
 @struct rx_buffer_s
 @brief buffer to hold the data fetched from the sx1302 RX buffer
 */
 typedef struct rx_buffer_s {
-    uint8_t buffer[4096];   /*!> byte array to hald the data fetched from the RX buffer */
+    uint8_t buffer[RX_BUFFER_SIZE]; /*!> byte array to hald the data fetched from the RX buffer */
     uint16_t buffer_size;   /*!> The number of bytes currently stored in the buffer */
     int buffer_index;       /*!> Current parsing index in the buffer */
-    uint8_t buffer_pkt_nb;
+    uint8_t buffer_pkt_nb;  /*!> The number of packets left to be parsed */
+    uint8_t pkt_nb;         /*!> The number of valid packets found in the buffer */
+    uint16_t pkt_offset[RX_BUFFER_PKT_NB_MAX]; /*!> Index of each valid packet in the buffer */
+    rx_buffer_stats_t stats;
 } rx_buffer_t;
 
 /* -------------------------------------------------------------------------- */
@@ -86,7 +105,7 @@ typedef struct rx_buffer_s {
 int rx_buffer_new(rx_buffer_t * self);
 
 /**
-@brief Reset the rx_buffer instance
+@brief Reset the rx_buffer instance, framing statistics are kept
 @param self     A pointer to a rx_buffer handler
 @return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
 */
@@ -99,6 +118,14 @@ int rx_buffer_del(rx_buffer_t * self);
 */
 int rx_buffer_fetch(rx_buffer_t * self);
 
+/**
+@brief Read the given number of bytes from the SX1302 RX buffer, when the byte count is already known, and frame the packets in one pass
+@param self     A pointer to a rx_buffer handler
+@param nb_bytes The number of bytes available in the SX1302 RX buffer
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int rx_buffer_load(rx_buffer_t * self, uint16_t nb_bytes);
+
 /**
 @brief Parse the rx_buffer and return the first packet available in the given structure.
 @param self     A pointer to a rx_buffer handler
@@ -107,6 +134,22 @@ int rx_buffer_fetch(rx_buffer_t * self);
 */
 int rx_buffer_pop(rx_buffer_t * self, rx_packet_t * pkt);
 
+/**
+@brief Get the payload size of the next packet to be popped, without parsing it
+@param self     A pointer to a rx_buffer handler
+@param size     A pointer to store the payload size
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR if there is no packet left
+*/
+int rx_buffer_peek_size(const rx_buffer_t * self, uint8_t * size);
+
+/**
+@brief Get the framing statistics of the rx_buffer
+@param self     A pointer to a rx_buffer handler
+@param stats    A pointer to the structure to be filled
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int rx_buffer_get_stats(rx_buffer_t * self, rx_buffer_stats_t * stats);
+
 #endif
 
 /* --- EOF ------------------------------------------------------------------ */
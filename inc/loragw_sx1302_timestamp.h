@@ -35,6 +35,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
+#define TIMESTAMP_MODEL_SAMPLE_NB   16  /* number of counter reads kept to fit the counter rate against the host clock */
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC MACROS -------------------------------------------------------- */
 
@@ -49,9 +51,28 @@ struct timestamp_info_s {
     uint32_t counter_us_27bits_ref;     /* reference value (last read) */
     uint8_t  counter_us_27bits_wrap;    /* rollover/wrap status */
 };
+
+/**
+@struct timestamp_model_s
+@brief linear model of the instantaneous counter against the host monotonic clock
+*/
+struct timestamp_model_s {
+    uint64_t host_us[TIMESTAMP_MODEL_SAMPLE_NB];    /* host time of the sample, middle of the register read */
+    uint64_t cnt_us[TIMESTAMP_MODEL_SAMPLE_NB];     /* 64-bits counter of the sample */
+    uint32_t jitter_us[TIMESTAMP_MODEL_SAMPLE_NB];  /* half duration of the register read */
+    uint8_t idx;        /* next slot to be written */
+    uint8_t size;       /* current size */
+    double rate;        /* counter microseconds per host microsecond */
+    double rate_err;    /* bound of the error on rate */
+};
+
 typedef struct timestamp_counter_s {
     struct timestamp_info_s inst; /* holds current reference of the instantaneous counter */
     struct timestamp_info_s pps;  /* holds current reference of the pps-trigged counter */
+    uint64_t inst_us_64bits;      /* instantaneous counter at the reference, never wraps */
+    uint64_t host_ref_us;         /* host monotonic time of the reference, 0 before the first read */
+    uint32_t host_ref_jitter_us;  /* half duration of the register read of the reference */
+    struct timestamp_model_s model; /* counter rate against the host clock */
 } timestamp_counter_t;
 
 /* -------------------------------------------------------------------------- */
@@ -76,9 +97,10 @@ void timestamp_counter_delete(timestamp_counter_t * self);
 @param self     Pointer to the counter handler
 @param pps      Current value of the pps counter to be used for the update
 @param cnt      Current value of the freerun counter to be used for the update
+@param host_req_us  Host monotonic time at which the counter registers read was requested, see timestamp_host_us()
 @return N/A
 */
-void timestamp_counter_update(timestamp_counter_t * self, uint32_t pps, uint32_t cnt);
+void timestamp_counter_update(timestamp_counter_t * self, uint32_t pps, uint32_t cnt, uint64_t host_req_us);
 
 /**
 @brief Convert the 27-bits counter given by the SX1302 to a 32-bits counter which wraps on a uint32_t.
@@ -89,6 +111,14 @@ void timestamp_counter_update(timestamp_counter_t * self, uint32_t pps, uint32_t
 */
 uint32_t timestamp_counter_expand(timestamp_counter_t * self, bool pps, uint32_t cnt_us);
 
+/**
+@brief Convert a 27-bits counter value latched before the last reference (packet timestamp, PPS) to a 64-bits counter
+@param self     Pointer to the counter handler
+@param cnt_us   The 27-bits counter to be expanded, less than a wrap older than the reference
+@return the 64-bits counter, which never wraps
+*/
+uint64_t timestamp_counter_expand64(timestamp_counter_t * self, uint32_t cnt_us);
+
 /**
 @brief Convert the 27-bits packet timestamp to a 32-bits counter which wraps on a uint32_t.
 @param self     Pointer to the counter handler
@@ -106,6 +136,49 @@ uint32_t timestamp_pkt_expand(timestamp_counter_t * self, uint32_t cnt_us);
 */
 int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t * pps);
 
+/**
+@brief Update the counter from two consecutive reads of the SX1302 counter registers, done by the caller
+@param self     Pointer to the counter handler
+@param buff     First read of the 8 counter bytes (PPS then freerun), re-read here if needed
+@param buff_wa  Second read of the 8 counter bytes, used to detect an inconsistent first read
+@param host_req_us  Host monotonic time taken just before the first read, see timestamp_host_us()
+@param inst     Current value of the freerun counter
+@param pps      Current value of the PPS counter
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+int timestamp_counter_process(timestamp_counter_t * self, uint8_t * buff, const uint8_t * buff_wa, uint64_t host_req_us, uint32_t * inst, uint32_t * pps);
+
+/**
+@brief Get the crystal correction factor tracked from the PPS (true time / counter time)
+@param xtal_correct Pointer to receive the correction factor
+@param sigma_ppm    Pointer to receive the standard deviation of the estimation, in ppm
+@return 0 if success, -1 if less than two consistent PPS have been seen
+
+The PPS latched with every counter read feeds a Kalman filter, so the
+estimation is smoothed over many PPS and is available from the second one.
+*/
+int timestamp_xtal_correct(double * xtal_correct, double * sigma_ppm);
+
+/**
+@brief Get the host monotonic clock, in microseconds
+@return the host time, never 0
+*/
+uint64_t timestamp_host_us(void);
+
+/**
+@brief Extrapolate the 64-bits instantaneous counter from the host clock, without reading any register
+@param self     Pointer to the counter handler
+@param host_us  Host monotonic time at which the counter is wanted, see timestamp_host_us()
+@param cnt_us   Pointer to receive the estimated 64-bits counter
+@param err_us   Pointer to receive the bound of the estimation error
+@return 0 if success, -1 if the counter has never been read or the last read is too old
+
+The estimate starts from the last counter read and goes forward at the counter
+rate fitted over the previous reads. The error bound adds the uncertainty of the
+last read, due to the USB round trip, and the rate error over the elapsed time.
+*/
+int timestamp_counter_estimate(timestamp_counter_t * self, uint64_t host_us, uint64_t * cnt_us, uint32_t * err_us);
+
 /**
 @brief Get the correction to applied to the LoRa packet timestamp (count_us)
 @param context          gateway configuration context
@@ -137,11 +210,15 @@ int timestamp_counter_mode(void);
 @param ts_metrics An array containing timestamp metrics to compute fine timestamp
 @param pkt_coarse_tmst The packet coarse timestamp
 @param sf packet spreading factor, used to shift timestamp from end of header to end of preamble
-@param if_freq_hz the IF frequency, to take into account DC noth delay
+@param dc_notch_delay the DC notch delay of the IF frequency, see sx1302_dc_notch_delay()
 @param result_ftime A pointer to store the resulting fine timestamp
 @return 0 if success, -1 otherwise
+
+The PPS reference is the last one saved in history by the counter update done
+with the packet fetch: no register is read here. The crystal error correction
+is the one tracked by timestamp_xtal_correct().
 */
-int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics, uint32_t pkt_coarse_tmst, uint8_t sf, int32_t if_freq_hz, double pkt_freq_error, uint32_t * result_ftime);
+int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics, uint32_t pkt_coarse_tmst, uint8_t sf, double dc_notch_delay, double pkt_freq_error, uint32_t * result_ftime);
 
 #endif
 
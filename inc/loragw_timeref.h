@@ -0,0 +1,142 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Time correlation between the concentrator counter, the host clocks and GPS time.
+    The GPS time of each PPS, given by the application which owns the GPS
+    receiver, is matched with the counter latched on the PPS edge
+    (lgw_get_trigcnt64()) to fit the counter offset and drift against GPS time.
+    Host clocks are matched with the counter extrapolated by the HAL
+    (lgw_get_instcnt_estimate()). Every conversion comes with an error bound.
+
+    All times are 64-bits microseconds: concentrator counter as returned by
+    lgw_get_instcnt64(), GPS time since the GPS epoch (6 Jan 1980, no leap
+    seconds), host CLOCK_REALTIME since the Unix epoch or CLOCK_MONOTONIC.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORAGW_TIMEREF_H
+#define _LORAGW_TIMEREF_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types*/
+#include <stdbool.h>    /* boolean type */
+
+#include "loragw_hal.h"
+
+#include "config.h"     /* library configuration options (dynamically generated) */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define LGW_TIMEREF_PPS_NB      32      /* number of PPS kept for the fit of the counter against GPS time */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/**
+@struct lgw_timeref_s
+@brief Time reference of the concentrator counter against GPS time, fitted over the last PPS
+*/
+struct lgw_timeref_s {
+    uint64_t    cnt_us[LGW_TIMEREF_PPS_NB]; /*!> counter latched on the PPS */
+    uint64_t    gps_us[LGW_TIMEREF_PPS_NB]; /*!> GPS time of the PPS */
+    uint8_t     idx;        /*!> next slot to be written */
+    uint8_t     size;       /*!> number of PPS in the fit */
+    uint64_t    cnt_ref;    /*!> counter of the last PPS, origin of the fit */
+    uint64_t    gps_ref;    /*!> GPS time of the last PPS, origin of the fit */
+    double      offset;     /*!> fitted counter at gps_ref, minus cnt_ref (us) */
+    double      rate;       /*!> counter microseconds per GPS microsecond (1 + crystal error) */
+    double      offset_err; /*!> bound of the error on offset (us) */
+    double      rate_err;   /*!> bound of the error on rate */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS ----------------------------------------------------- */
+
+/**
+@brief Clear a time reference, to be called on start and when the GPS fix is lost
+@param ref pointer to the time reference
+@return N/A
+*/
+void lgw_timeref_reset(struct lgw_timeref_s * ref);
+
+/**
+@brief Add a PPS to the time reference, and fit the counter against GPS time again
+@param ref pointer to the time reference
+@param trig_cnt_us counter latched on the PPS, from lgw_get_trigcnt64()
+@param gps_us GPS time of that PPS
+@return LGW_HAL_ERROR if the PPS is not consistent with the previous ones (the fit restarts from it), LGW_HAL_SUCCESS else
+
+The same PPS given again (polling faster than 1 Hz) is ignored.
+*/
+int lgw_timeref_sync(struct lgw_timeref_s * ref, uint64_t trig_cnt_us, uint64_t gps_us);
+
+/**
+@brief Convert a concentrator counter value to GPS time
+@param ref pointer to a synchronized time reference
+@param count_us counter value
+@param gps_us pointer to receive the GPS time
+@param err_us pointer to receive the bound of the error on gps_us
+@return LGW_HAL_ERROR if the reference has no PPS, LGW_HAL_SUCCESS else
+*/
+int lgw_cnt2gps(const struct lgw_timeref_s * ref, uint64_t count_us, uint64_t * gps_us, uint32_t * err_us);
+
+/**
+@brief Convert a GPS time to a concentrator counter value
+@param ref pointer to a synchronized time reference
+@param gps_us GPS time
+@param count_us pointer to receive the counter value
+@param err_us pointer to receive the bound of the error on count_us
+@return LGW_HAL_ERROR if the reference has no PPS, LGW_HAL_SUCCESS else
+*/
+int lgw_gps2cnt(const struct lgw_timeref_s * ref, uint64_t gps_us, uint64_t * count_us, uint32_t * err_us);
+
+/**
+@brief Convert a concentrator counter value to host time
+@param ref pointer to a time reference for the counter drift, NULL or not synchronized to assume the nominal rate
+@param realtime true for CLOCK_REALTIME, false for CLOCK_MONOTONIC
+@param count_us counter value
+@param host_us pointer to receive the host time
+@param err_us pointer to receive the bound of the error on host_us
+@return LGW_HAL_ERROR if the counter could not be read, LGW_HAL_SUCCESS else
+*/
+int lgw_cnt2host(const struct lgw_timeref_s * ref, bool realtime, uint64_t count_us, uint64_t * host_us, uint32_t * err_us);
+
+/**
+@brief Convert a host time to a concentrator counter value
+@param ref pointer to a time reference for the counter drift, NULL or not synchronized to assume the nominal rate
+@param realtime true for CLOCK_REALTIME, false for CLOCK_MONOTONIC
+@param host_us host time
+@param count_us pointer to receive the counter value
+@param err_us pointer to receive the bound of the error on count_us
+@return LGW_HAL_ERROR if the counter could not be read, LGW_HAL_SUCCESS else
+*/
+int lgw_host2cnt(const struct lgw_timeref_s * ref, bool realtime, uint64_t host_us, uint64_t * count_us, uint32_t * err_us);
+
+/**
+@brief Set the TX mode and count_us of a packet to be sent at a GPS time
+@param ref pointer to a synchronized time reference
+@param gps_us GPS time of the start of the preamble
+@param pkt_data pointer to the packet, its tx_mode selects ON_GPS or TIMESTAMPED
+@return LGW_HAL_ERROR if the time cannot be reached in the requested mode, LGW_HAL_SUCCESS else
+
+In ON_GPS mode, the packet is emitted on the next PPS (plus lgw_i_tx_start_delay_us,
+see lgw_send()): gps_us must be a whole second and that PPS must be the next one,
+with enough time left to send the packet to the concentrator.
+Any other tx_mode is set to TIMESTAMPED, with count_us converted from gps_us.
+*/
+int lgw_gps2tx(const struct lgw_timeref_s * ref, uint64_t gps_us, struct lgw_pkt_tx_s * pkt_data);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
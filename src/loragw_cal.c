@@ -0,0 +1,194 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Radio image calibration result cache.
+    Keeps, for each radio, the band, device errors and temperature of the last
+    successful image calibration, so that it can be skipped while the band and
+    temperature still match. The cache can be saved by the application and
+    given back on next start.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* boolean type */
+#include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memcmp */
+#include <math.h>       /* fabs, lroundf */
+
+#include "loragw_cal.h"
+#include "loragw_reg.h"
+#include "loragw_sx1250.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_CAL == 1
+    #define DEBUG_MSG(str)                fprintf(stdout, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stdout,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+    #define CHECK_NULL(a)                if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return LGW_REG_ERROR;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                if(a==NULL){return LGW_REG_ERROR;}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CAL_TEMP_WINDOW         10.0    /* maximum temperature drift (C) before forcing a new calibration */
+#define CAL_BAND_NONE           0xFF
+
+/* Serialized cache: magic, format version, number of radios, then one record per radio */
+#define CAL_BLOB_MAGIC          "LGWC"
+#define CAL_BLOB_VERSION        1
+#define CAL_BLOB_HDR_SIZE       6
+#define CAL_BLOB_RECORD_SIZE    5       /* band, device errors (2 bytes), temperature in 0.01 C (2 bytes) */
+#define CAL_BLOB_SIZE           (CAL_BLOB_HDR_SIZE + CAL_RADIO_NB * CAL_BLOB_RECORD_SIZE)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct cal_record_s {
+    uint8_t band;           /* image calibration band, CAL_BAND_NONE if no record */
+    uint16_t dev_errors;    /* GET_DEVICE_ERRORS after calibration */
+    float temperature;      /* board temperature at calibration */
+    bool applied;           /* calibration run on the radio since the library was loaded */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static struct cal_record_s cal_cache[CAL_RADIO_NB] = {
+    { CAL_BAND_NONE, 0, 0.0, false },
+    { CAL_BAND_NONE, 0, 0.0, false },
+    { CAL_BAND_NONE, 0, 0.0, false }
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+bool cal_cache_match(uint8_t radio, uint32_t freq_hz, float temperature, bool applied) {
+    struct cal_record_s * rec;
+    int band;
+
+    if (radio >= CAL_RADIO_NB) {
+        return false;
+    }
+    rec = &cal_cache[radio];
+
+    /* SX1250 and SX1261 share the same image calibration bands */
+    band = sx1250_calibrate_band(freq_hz);
+    if ((band < 0) || (rec->band != (uint8_t)band) || (rec->dev_errors != 0)) {
+        return false;
+    }
+    if ((applied == true) && (rec->applied == false)) {
+        return false;
+    }
+    if (fabs(temperature - rec->temperature) > CAL_TEMP_WINDOW) {
+        printf("INFO: radio %u: temperature drifted from %.1f C to %.1f C since calibration\n", radio, rec->temperature, temperature);
+        return false;
+    }
+
+    DEBUG_PRINTF("INFO: radio %u: reusing calibration for band %u (%.1f C)\n", radio, rec->band, rec->temperature);
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int cal_cache_store(uint8_t radio, uint32_t freq_hz, uint16_t dev_errors, float temperature) {
+    int band;
+
+    if (radio >= CAL_RADIO_NB) {
+        DEBUG_MSG("ERROR: invalid radio\n");
+        return LGW_REG_ERROR;
+    }
+    band = sx1250_calibrate_band(freq_hz);
+    if (band < 0) {
+        DEBUG_PRINTF("ERROR: no calibration band for %u Hz\n", freq_hz);
+        return LGW_REG_ERROR;
+    }
+
+    cal_cache[radio].band = (uint8_t)band;
+    cal_cache[radio].dev_errors = dev_errors;
+    cal_cache[radio].temperature = temperature;
+    cal_cache[radio].applied = true;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void cal_cache_radio_reset(uint8_t radio) {
+    if (radio < CAL_RADIO_NB) {
+        cal_cache[radio].applied = false;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int cal_cache_get(uint8_t * blob, uint16_t max_size, uint16_t * size) {
+    int i;
+    int16_t temp_reg;
+    uint8_t * rec;
+
+    CHECK_NULL(blob);
+    CHECK_NULL(size);
+
+    if (max_size < CAL_BLOB_SIZE) {
+        printf("ERROR: calibration cache needs %d bytes, only %u available\n", CAL_BLOB_SIZE, max_size);
+        return LGW_REG_ERROR;
+    }
+
+    memcpy(blob, CAL_BLOB_MAGIC, 4);
+    blob[4] = CAL_BLOB_VERSION;
+    blob[5] = CAL_RADIO_NB;
+    for (i = 0; i < CAL_RADIO_NB; i++) {
+        rec = &blob[CAL_BLOB_HDR_SIZE + i * CAL_BLOB_RECORD_SIZE];
+        temp_reg = (int16_t)lroundf(cal_cache[i].temperature * 100.0);
+        rec[0] = cal_cache[i].band;
+        rec[1] = (uint8_t)(cal_cache[i].dev_errors >> 8);
+        rec[2] = (uint8_t)(cal_cache[i].dev_errors >> 0);
+        rec[3] = (uint8_t)((uint16_t)temp_reg >> 8);
+        rec[4] = (uint8_t)((uint16_t)temp_reg >> 0);
+    }
+    *size = CAL_BLOB_SIZE;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int cal_cache_set(const uint8_t * blob, uint16_t size) {
+    int i;
+    const uint8_t * rec;
+
+    CHECK_NULL(blob);
+
+    if ((size != CAL_BLOB_SIZE) || (memcmp(blob, CAL_BLOB_MAGIC, 4) != 0) || (blob[4] != CAL_BLOB_VERSION) || (blob[5] != CAL_RADIO_NB)) {
+        printf("ERROR: invalid calibration cache (size:%u)\n", size);
+        return LGW_REG_ERROR;
+    }
+
+    for (i = 0; i < CAL_RADIO_NB; i++) {
+        rec = &blob[CAL_BLOB_HDR_SIZE + i * CAL_BLOB_RECORD_SIZE];
+        cal_cache[i].band = rec[0];
+        cal_cache[i].dev_errors = ((uint16_t)rec[1] << 8) | rec[2];
+        cal_cache[i].temperature = (float)(int16_t)(((uint16_t)rec[3] << 8) | rec[4]) / 100.0;
+        cal_cache[i].applied = false; /* the radio may have been powered off since */
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
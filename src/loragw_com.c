@@ -301,6 +301,67 @@ int lgw_com_rb(uint8_t spi_mux_target, uint16_t address, uint8_t *data, uint16_t
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+/* Multiple burst reads, one USB exchange */
+int lgw_com_rb_multi(uint8_t spi_mux_target, const lgw_com_rb_req_t * req, uint8_t nb_req) {
+    /* Check input parameters */
+    CHECK_NULL(req);
+
+    uint16_t command_size = 0;
+    int i, a = 0;
+    uint16_t idx;
+
+    for (i = 0; i < nb_req; i++) {
+        CHECK_NULL(req[i].data);
+        command_size += req[i].size + 9; /* 5 bytes: REQ metadata (MCU), 3 bytes: SPI header (SX1302), 1 byte: dummy */
+    }
+    if ((nb_req == 0) || (command_size > LGW_USB_BURST_CHUNK)) {
+        printf("ERROR: USB READ BURST FAILURE - invalid multiple read (nb_req:%u size:%u)\n", nb_req, command_size);
+        return -1;
+    }
+    if (_lgw_write_mode == LGW_COM_WRITE_MODE_BULK) {
+        printf("ERROR: USB READ BURST FAILURE - bulk mode is enabled\n");
+        return -1;
+    }
+
+    uint8_t in_out_buf[command_size];
+
+    /* prepare command: one read request per burst, the ACK has the same layout */
+    idx = 0;
+    for (i = 0; i < nb_req; i++) {
+        /* Request metadata */
+        in_out_buf[idx + 0] = (uint8_t)i; /* Req ID */
+        in_out_buf[idx + 1] = MCU_SPI_REQ_TYPE_READ_WRITE; /* Req type */
+        in_out_buf[idx + 2] = MCU_SPI_TARGET_SX1302; /* MCU -> SX1302 */
+        in_out_buf[idx + 3] = (uint8_t)((req[i].size + 4) >> 8); /* payload size + spi_mux_target + address + dummy byte */
+        in_out_buf[idx + 4] = (uint8_t)((req[i].size + 4) >> 0); /* payload size + spi_mux_target + address + dummy byte */
+        /* RAW SPI frame */
+        in_out_buf[idx + 5] = spi_mux_target; /* SX1302 -> RADIO_A or RADIO_B */
+        in_out_buf[idx + 6] = 0x00 | ((req[i].address >> 8) & 0x7F);
+        in_out_buf[idx + 7] =        ((req[i].address >> 0) & 0xFF);
+        in_out_buf[idx + 8] = 0x00; /* dummy byte */
+        memset(&in_out_buf[idx + 9], 0, req[i].size);
+        idx += req[i].size + 9;
+    }
+
+    a = mcu_spi_write(in_out_buf, command_size);
+
+    /* determine return code */
+    if (a != 0) {
+        DEBUG_MSG("ERROR: USB READ BURST FAILURE\n");
+        return -1;
+    } else {
+        DEBUG_MSG("Note: USB read burst success\n");
+        idx = 0;
+        for (i = 0; i < nb_req; i++) {
+            memcpy(req[i].data, in_out_buf + idx + 9, req[i].size); /* remove the first bytes, keep only the payload */
+            idx += req[i].size + 9;
+        }
+        return 0;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_com_set_write_mode(lgw_com_write_mode_t write_mode) {
     if (write_mode >= LGW_COM_WRITE_MODE_UNKNOWN) {
         printf("ERROR: wrong write mode\n");
@@ -30,8 +30,16 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
 #include <string.h>     /* memcpy */
-#include <unistd.h>     /* symlink, unlink */
+#include <unistd.h>     /* symlink, unlink, read, write, close */
 #include <inttypes.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+    #include <windows.h>    /* CreateEvent, SetEvent, WaitForSingleObject */
+#else
+    #include <poll.h>           /* poll */
+    #include <sys/eventfd.h>    /* eventfd */
+#endif
 
 #include "loragw_reg.h"
 #include "loragw_hal.h"
@@ -41,6 +49,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "loragw_sx1261.h"
 #include "loragw_sx1302.h"
 #include "loragw_sx1302_timestamp.h"
+#include "loragw_cal.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- DEBUG CONSTANTS ------------------------------------------------------ */
@@ -72,6 +81,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define CONTEXT_DEMOD           lgw_context.demod_cfg
 #define CONTEXT_LORA_SERVICE    lgw_context.lora_service_cfg
 #define CONTEXT_FSK             lgw_context.fsk_cfg
+#define CONTEXT_RX_FILTER       lgw_context.rx_filter_cfg
 #define CONTEXT_SX1261          lgw_context.sx1261_cfg
 
 /* -------------------------------------------------------------------------- */
@@ -91,6 +101,31 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define LGW_RF_RX_FREQ_MIN          100E6
 #define LGW_RF_RX_FREQ_MAX          1E9
 
+/* Configuration snapshot blob: header followed by the SX1302 register image */
+#define SNAPSHOT_MAGIC              "LGWS"
+#define SNAPSHOT_FORMAT_VERSION     1
+#define SNAPSHOT_HDR_VERSION        4   /* offset of format version */
+#define SNAPSHOT_HDR_HASH           5   /* offset of configuration hash (4 bytes) */
+#define SNAPSHOT_HDR_RF_CHAIN       9   /* offset of radio settings: enable, freq_hz (4 bytes), single_input_mode */
+#define SNAPSHOT_HDR_RF_CHAIN_SIZE  6
+#define SNAPSHOT_HDR_CLKSRC         (SNAPSHOT_HDR_RF_CHAIN + LGW_RF_CHAIN_NB * SNAPSHOT_HDR_RF_CHAIN_SIZE)
+#define SNAPSHOT_HDR_IMAGE_SIZE     (SNAPSHOT_HDR_CLKSRC + 1) /* 2 bytes */
+#define SNAPSHOT_HDR_SIZE           (SNAPSHOT_HDR_IMAGE_SIZE + 2)
+
+#define RX_RING_MASK                (LGW_RX_RING_SIZE - 1)
+#define RX_THREAD_FETCH_MAX         16  /* packets parsed per iteration when the ring is full */
+
+#define TEMPERATURE_INTERVAL_MS_DEFAULT 10000 /* temperature sampling interval for RSSI compensation */
+
+#define RX_WAIT_INTERVAL_MIN_MS     1   /* lgw_receive_wait() poll interval bounds */
+#define RX_WAIT_INTERVAL_MAX_MS     100
+#define RX_WAIT_FIFO_HALF_BYTES     2048 /* half of the SX1302 RX buffer */
+
+#define RX_DEDUP_TABLE_SIZE         64  /* recently received frames, power of 2 */
+#define RX_DEDUP_PROBE_NB           4
+
+#define RX_ARENA_NONE               UINT32_MAX /* receive_views() arena size when packets are not copied to an arena */
+
 /* Version string, used to identify the library version/options once compiled */
 const char lgw_version_string[] = "Version: " LIBLORAGW_VERSION ";";
 
@@ -144,12 +179,86 @@ static lgw_context_t lgw_context = {
     }
 };
 
+/* Configuration snapshot captured by, or to be restored by, lgw_start() */
+static uint8_t snapshot_blob[LGW_SNAPSHOT_SIZE_MAX];
+static uint16_t snapshot_size = 0; /* 0 when no snapshot is available */
+
+/* Set when lgw_reconfigure() failed half way and could not restore the previous configuration */
+static bool reconf_restart_needed = false;
+
+/* RSSI compensation: board offset + temperature offset of each RF chain, for the last temperature sampled */
+static float rssi_chain_offset[LGW_RF_CHAIN_NB];
+static float rssi_temperature;
+static bool rssi_temperature_valid = false;
+static struct timeval rssi_temperature_time;
+
+/* lgw_receive_wait() poll cadence */
+static uint32_t rx_wait_interval_ms = RX_WAIT_INTERVAL_MIN_MS; /* current interval between polls */
+static uint32_t rx_wait_arrival_ms = RX_WAIT_INTERVAL_MAX_MS;   /* average time between polls returning packets */
+static uint64_t rx_wait_last_arrival_us = 0;                     /* host monotonic time of the last arrival, 0 before the first one */
+
+/* Recently received frames, for duplicate suppression */
+struct rx_dedup_entry_s {
+    uint32_t hash;          /* hash of payload and CRC, 0 for an empty entry */
+    uint32_t count_us;
+    uint32_t batch;         /* receive call the frame was returned by */
+    int16_t index;          /* index of the frame in that call's packets */
+};
+static struct rx_dedup_entry_s rx_dedup[RX_DEDUP_TABLE_SIZE];
+static uint32_t rx_dedup_batch = 0;
+static uint32_t rx_dedup_nb_drop = 0;
+
+/* Packets parsed in place by lgw_receive(), before their payload is copied out */
+static struct lgw_pkt_rx_view_s rx_view[UINT8_MAX];
+
+/*
+Background RX acquisition: the thread is the only producer of the ring, the
+application the only consumer. head is written by the producer only, tail by
+the consumer only, both free-running (index = value & RX_RING_MASK).
+mx_concent serializes the concentrator accesses of the application with the
+ones of the thread.
+*/
+static struct lgw_pkt_rx_s rx_ring[LGW_RX_RING_SIZE];
+static uint32_t rx_ring_head = 0;
+static uint32_t rx_ring_tail = 0;
+static struct lgw_rx_thread_stats_s rx_thread_stats;
+static pthread_t rx_thread;
+static bool rx_thread_running = false;
+static bool rx_thread_quit = false;
+static uint32_t rx_thread_poll_ms = 0;
+static pthread_mutex_t mx_concent = PTHREAD_MUTEX_INITIALIZER; /* control access to the concentrator */
+#ifdef _WIN32
+static HANDLE rx_thread_event = NULL;
+#else
+static int rx_thread_event = -1;
+#endif
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
 int32_t lgw_sf_getval(int x);
 int32_t lgw_bw_getval(int x);
 
+static int lgw_sx1302_configure(void);
+static int if_range_check(int32_t freq_hz, uint8_t bandwidth);
+static int reconfigure_write(lgw_context_t * ctx, bool multisf_changed, bool service_changed, bool fsk_changed, bool syncword_changed);
+static uint32_t hash_fnv1a(uint32_t hash, const void * data, size_t size);
+static uint32_t context_hash(void);
+static void snapshot_header_write(uint8_t * hdr, uint16_t image_size);
+static bool snapshot_is_valid(void);
+static void rssi_tcomp_set(float temperature);
+static int rssi_tcomp_update(void);
+static void rssi_compensate(struct lgw_pkt_rx_view_s * p);
+static bool rx_dedup_check(struct lgw_pkt_rx_view_s * pkt_view, int index);
+static int receive_views(uint8_t max_pkt, struct lgw_pkt_rx_view_s * pkt_view, bool rssi_raw, uint32_t arena_size, uint8_t * nb_pkt_left);
+static int receive_packets(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, uint8_t * nb_pkt_left);
+static void concentrator_lock(void);
+static void concentrator_unlock(void);
+static void rx_thread_signal(void);
+static void * rx_thread_loop(void * arg);
+static uint32_t rx_wait_interval_floor(void);
+static uint32_t rx_wait_interval_ceil(void);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -178,581 +287,2042 @@ int32_t lgw_sf_getval(int x) {
     }
 }
 
-/* -------------------------------------------------------------------------- */
-/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_board_setconf(struct lgw_conf_board_s * conf) {
-    CHECK_NULL(conf);
+static int if_range_check(int32_t freq_hz, uint8_t bandwidth) {
+    int32_t bw_hz;
+    uint32_t rf_rx_bandwidth;
 
-    /* check if the concentrator is running */
-    if (CONTEXT_STARTED == true) {
-        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+    /* check if IF frequency is optimal based on channel and radio bandwidths */
+    switch (bandwidth) {
+        case BW_250KHZ:
+            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_250KHZ; /* radio bandwidth */
+            break;
+        case BW_500KHZ:
+            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_500KHZ; /* radio bandwidth */
+            break;
+        default:
+            /* For 125KHz and below */
+            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_125KHZ; /* radio bandwidth */
+            break;
+    }
+    bw_hz = lgw_bw_getval(bandwidth); /* channel bandwidth */
+    if ((freq_hz + ((bw_hz==-1)?LGW_REF_BW:bw_hz)/2) > ((int32_t)rf_rx_bandwidth/2)) {
+        DEBUG_PRINTF("ERROR: IF FREQUENCY %d TOO HIGH\n", freq_hz);
+        return LGW_HAL_ERROR;
+    } else if ((freq_hz - ((bw_hz==-1)?LGW_REF_BW:bw_hz)/2) < -((int32_t)rf_rx_bandwidth/2)) {
+        DEBUG_PRINTF("ERROR: IF FREQUENCY %d TOO LOW\n", freq_hz);
         return LGW_HAL_ERROR;
     }
 
-    /* set internal config according to parameters */
-    CONTEXT_LWAN_PUBLIC = conf->lorawan_public;
-    CONTEXT_BOARD.clksrc = conf->clksrc;
-    strncpy(CONTEXT_COM_PATH, conf->com_path, sizeof CONTEXT_COM_PATH);
-    CONTEXT_COM_PATH[sizeof CONTEXT_COM_PATH - 1] = '\0'; /* ensure string termination */
-
-    DEBUG_PRINTF("Note: board configuration: com_type: %s, com_path: %s, lorawan_public:%d, clksrc:%d,\n",   "USB",
-                                                                                                                            CONTEXT_COM_PATH,
-                                                                                                                            CONTEXT_LWAN_PUBLIC,
-                                                                                                                            CONTEXT_BOARD.clksrc);
-
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s * conf) {
-    CHECK_NULL(conf);
+static int lgw_sx1302_configure(void) {
+    int err;
 
-    /* check if the concentrator is running */
-    if (CONTEXT_STARTED == true) {
-        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+    /* Basic initialization of the sx1302 */
+    err = sx1302_init();
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to initialize SX1302\n");
         return LGW_HAL_ERROR;
     }
 
-    if (conf->enable == false) {
-        /* nothing to do */
-        DEBUG_PRINTF("Note: rf_chain %d disabled\n", rf_chain);
-        return LGW_HAL_SUCCESS;
+    /* Configure PA/LNA LUTs */
+    err = sx1302_pa_lna_lut_configure();
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 PA/LNA LUT\n");
+        return LGW_HAL_ERROR;
     }
 
-    /* check input range (segfault prevention) */
-    if (rf_chain >= LGW_RF_CHAIN_NB) {
-        DEBUG_MSG("ERROR: NOT A VALID RF_CHAIN NUMBER\n");
+    /* Configure Radio FE */
+    err = sx1302_radio_fe_configure();
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 radio frontend\n");
         return LGW_HAL_ERROR;
     }
 
-    /* check if the radio central frequency is valid */
-    if ((conf->freq_hz < LGW_RF_RX_FREQ_MIN) || (conf->freq_hz > LGW_RF_RX_FREQ_MAX)) {
-        DEBUG_PRINTF("ERROR: NOT A VALID RADIO CENTER FREQUENCY, PLEASE CHECK IF IT HAS BEEN GIVEN IN HZ (%u)\n", conf->freq_hz);
+    /* Configure the Channelizer */
+    err = sx1302_channelizer_configure(CONTEXT_IF_CHAIN, false);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 channelizer\n");
         return LGW_HAL_ERROR;
     }
 
-    /* set internal config according to parameters */
-    CONTEXT_RF_CHAIN[rf_chain].enable = conf->enable;
-    CONTEXT_RF_CHAIN[rf_chain].freq_hz = conf->freq_hz;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_offset = conf->rssi_offset;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_a = conf->rssi_tcomp.coeff_a;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_b = conf->rssi_tcomp.coeff_b;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_c = conf->rssi_tcomp.coeff_c;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_d = conf->rssi_tcomp.coeff_d;
-    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_e = conf->rssi_tcomp.coeff_e;
-    CONTEXT_RF_CHAIN[rf_chain].tx_enable = conf->tx_enable;
-    CONTEXT_RF_CHAIN[rf_chain].single_input_mode = conf->single_input_mode;
-
-    DEBUG_PRINTF("Note: rf_chain %d configuration; en:%d freq:%d rssi_offset:%f tx_enable:%d single_input_mode:%d\n",  rf_chain,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].enable,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].freq_hz,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].rssi_offset,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].type,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].tx_enable,
-                                                                                                                CONTEXT_RF_CHAIN[rf_chain].single_input_mode);
-
-    return LGW_HAL_SUCCESS;
-}
-
-/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
-
-int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s * conf) {
-    int32_t bw_hz;
-    uint32_t rf_rx_bandwidth;
-
-    CHECK_NULL(conf);
-
-    /* check if the concentrator is running */
-    if (CONTEXT_STARTED == true) {
-        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+    /* configure LoRa 'multi-sf' modems */
+    err = sx1302_lora_correlator_configure(CONTEXT_IF_CHAIN, &(CONTEXT_DEMOD));
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 LoRa modem correlators\n");
         return LGW_HAL_ERROR;
     }
-
-    /* check input range (segfault prevention) */
-    if (if_chain >= LGW_IF_CHAIN_NB) {
-        DEBUG_PRINTF("ERROR: %d NOT A VALID IF_CHAIN NUMBER\n", if_chain);
+    err = sx1302_lora_modem_configure(CONTEXT_RF_CHAIN[0].freq_hz);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 LoRa modems\n");
         return LGW_HAL_ERROR;
     }
 
-    /* if chain is disabled, don't care about most parameters */
-    if (conf->enable == false) {
-        CONTEXT_IF_CHAIN[if_chain].enable = false;
-        CONTEXT_IF_CHAIN[if_chain].freq_hz = 0;
-        DEBUG_PRINTF("Note: if_chain %d disabled\n", if_chain);
-        return LGW_HAL_SUCCESS;
+    /* configure LoRa 'single-sf' modem */
+    if (CONTEXT_IF_CHAIN[8].enable == true) {
+        err = sx1302_lora_service_correlator_configure(&(CONTEXT_LORA_SERVICE));
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to configure SX1302 LoRa Service modem correlators\n");
+            return LGW_HAL_ERROR;
+        }
+        err = sx1302_lora_service_modem_configure(&(CONTEXT_LORA_SERVICE), CONTEXT_RF_CHAIN[0].freq_hz);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to configure SX1302 LoRa Service modem\n");
+            return LGW_HAL_ERROR;
+        }
     }
 
-    /* check 'general' parameters */
-    if (sx1302_get_ifmod_config(if_chain) == IF_UNDEFINED) {
-        DEBUG_PRINTF("ERROR: IF CHAIN %d NOT CONFIGURABLE\n", if_chain);
+    /* configure FSK modem */
+    if (CONTEXT_IF_CHAIN[9].enable == true) {
+        err = sx1302_fsk_configure(&(CONTEXT_FSK));
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to configure SX1302 FSK modem\n");
+            return LGW_HAL_ERROR;
+        }
     }
-    if (conf->rf_chain >= LGW_RF_CHAIN_NB) {
-        DEBUG_MSG("ERROR: INVALID RF_CHAIN TO ASSOCIATE WITH A LORA_STD IF CHAIN\n");
+
+    /* configure syncword */
+    err = sx1302_lora_syncword(CONTEXT_LWAN_PUBLIC, CONTEXT_LORA_SERVICE.datarate);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 LoRa syncword\n");
         return LGW_HAL_ERROR;
     }
-    /* check if IF frequency is optimal based on channel and radio bandwidths */
-    switch (conf->bandwidth) {
-        case BW_250KHZ:
-            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_250KHZ; /* radio bandwidth */
-            break;
-        case BW_500KHZ:
-            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_500KHZ; /* radio bandwidth */
-            break;
-        default:
-            /* For 125KHz and below */
-            rf_rx_bandwidth = LGW_RF_RX_BANDWIDTH_125KHZ; /* radio bandwidth */
-            break;
-    }
-    bw_hz = lgw_bw_getval(conf->bandwidth); /* channel bandwidth */
-    if ((conf->freq_hz + ((bw_hz==-1)?LGW_REF_BW:bw_hz)/2) > ((int32_t)rf_rx_bandwidth/2)) {
-        DEBUG_PRINTF("ERROR: IF FREQUENCY %d TOO HIGH\n", conf->freq_hz);
-        return LGW_HAL_ERROR;
-    } else if ((conf->freq_hz - ((bw_hz==-1)?LGW_REF_BW:bw_hz)/2) < -((int32_t)rf_rx_bandwidth/2)) {
-        DEBUG_PRINTF("ERROR: IF FREQUENCY %d TOO LOW\n", conf->freq_hz);
+
+    /* enable demodulators - to be done before starting AGC/ARB */
+    err = sx1302_modem_enable();
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to enable SX1302 modems\n");
         return LGW_HAL_ERROR;
     }
 
-    /* check parameters according to the type of IF chain + modem,
-    fill default if necessary, and commit configuration if everything is OK */
-    switch (sx1302_get_ifmod_config(if_chain)) {
-        case IF_LORA_STD:
-            /* fill default parameters if needed */
-            if (conf->bandwidth == BW_UNDEFINED) {
-                conf->bandwidth = BW_250KHZ;
-            }
-            if (conf->datarate == DR_UNDEFINED) {
-                conf->datarate = DR_LORA_SF7;
-            }
-            /* check BW & DR */
-            if (!IS_LORA_BW(conf->bandwidth)) {
-                DEBUG_MSG("ERROR: BANDWIDTH NOT SUPPORTED BY LORA_STD IF CHAIN\n");
-                return LGW_HAL_ERROR;
-            }
-            if (!IS_LORA_DR(conf->datarate)) {
-                DEBUG_MSG("ERROR: DATARATE NOT SUPPORTED BY LORA_STD IF CHAIN\n");
-                return LGW_HAL_ERROR;
-            }
-            /* set internal configuration  */
-            CONTEXT_IF_CHAIN[if_chain].enable = conf->enable;
-            CONTEXT_IF_CHAIN[if_chain].rf_chain = conf->rf_chain;
-            CONTEXT_IF_CHAIN[if_chain].freq_hz = conf->freq_hz;
-            CONTEXT_LORA_SERVICE.bandwidth = conf->bandwidth;
-            CONTEXT_LORA_SERVICE.datarate = conf->datarate;
-            CONTEXT_LORA_SERVICE.implicit_hdr = conf->implicit_hdr;
-            CONTEXT_LORA_SERVICE.implicit_payload_length = conf->implicit_payload_length;
-            CONTEXT_LORA_SERVICE.implicit_crc_en   = conf->implicit_crc_en;
-            CONTEXT_LORA_SERVICE.implicit_coderate = conf->implicit_coderate;
+    return LGW_HAL_SUCCESS;
+}
 
-            DEBUG_PRINTF("Note: LoRa 'std' if_chain %d configuration; en:%d freq:%d bw:%d dr:%d\n", if_chain,
-                                                                                                    CONTEXT_IF_CHAIN[if_chain].enable,
-                                                                                                    CONTEXT_IF_CHAIN[if_chain].freq_hz,
-                                                                                                    CONTEXT_LORA_SERVICE.bandwidth,
-                                                                                                    CONTEXT_LORA_SERVICE.datarate);
-            break;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-        case IF_LORA_MULTI:
-            /* fill default parameters if needed */
-            if (conf->bandwidth == BW_UNDEFINED) {
-                conf->bandwidth = BW_125KHZ;
+static int reconfigure_write(lgw_context_t * ctx, bool multisf_changed, bool service_changed, bool fsk_changed, bool syncword_changed) {
+    int err;
+
+    if ((multisf_changed == true) || (service_changed == true) || (fsk_changed == true)) {
+        err = sx1302_channelizer_configure(ctx->if_chain_cfg, false);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to reconfigure SX1302 channelizer\n");
+            return LGW_HAL_ERROR;
+        }
+        if (multisf_changed == true) {
+            DEBUG_MSG("INFO: reconfiguring LoRa 'multi-sf' correlators\n");
+            err = sx1302_lora_correlator_configure(ctx->if_chain_cfg, &(ctx->demod_cfg));
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to reconfigure SX1302 LoRa modem correlators\n");
+                return LGW_HAL_ERROR;
             }
-            if (conf->datarate == DR_UNDEFINED) {
-                conf->datarate = DR_LORA_SF7;
+        }
+        if ((service_changed == true) && (ctx->if_chain_cfg[8].enable == true)) {
+            DEBUG_MSG("INFO: reconfiguring LoRa 'single-sf' modem\n");
+            err = sx1302_lora_service_correlator_configure(&(ctx->lora_service_cfg));
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to reconfigure SX1302 LoRa Service modem correlators\n");
+                return LGW_HAL_ERROR;
             }
-            /* check BW & DR */
-            if (conf->bandwidth != BW_125KHZ) {
-                DEBUG_MSG("ERROR: BANDWIDTH NOT SUPPORTED BY LORA_MULTI IF CHAIN\n");
+            err = sx1302_lora_service_modem_configure(&(ctx->lora_service_cfg), ctx->rf_chain_cfg[0].freq_hz);
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to reconfigure SX1302 LoRa Service modem\n");
                 return LGW_HAL_ERROR;
             }
-            if (!IS_LORA_DR(conf->datarate)) {
-                DEBUG_MSG("ERROR: DATARATE(S) NOT SUPPORTED BY LORA_MULTI IF CHAIN\n");
+        }
+        if ((fsk_changed == true) && (ctx->if_chain_cfg[9].enable == true)) {
+            DEBUG_MSG("INFO: reconfiguring FSK modem\n");
+            err = sx1302_fsk_configure(&(ctx->fsk_cfg));
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to reconfigure SX1302 FSK modem\n");
                 return LGW_HAL_ERROR;
             }
-            /* set internal configuration  */
-            CONTEXT_IF_CHAIN[if_chain].enable = conf->enable;
-            CONTEXT_IF_CHAIN[if_chain].rf_chain = conf->rf_chain;
-            CONTEXT_IF_CHAIN[if_chain].freq_hz = conf->freq_hz;
+        }
+    }
+    if (syncword_changed == true) {
+        err = sx1302_lora_syncword(ctx->board_cfg.lorawan_public, ctx->lora_service_cfg.datarate);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to reconfigure SX1302 LoRa syncword\n");
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t hash_fnv1a(uint32_t hash, const void * data, size_t size) {
+    const uint8_t * p = (const uint8_t *)data;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t context_hash(void) {
+    uint32_t hash = 2166136261U;
+    struct lgw_conf_rxif_s * if_cfg;
+    int i;
+
+    /* Only the parameters which end up in SX1302 registers or radio setup, field by field to skip padding */
+    hash = hash_fnv1a(hash, lgw_version_string, sizeof lgw_version_string);
+    hash = hash_fnv1a(hash, &CONTEXT_LWAN_PUBLIC, sizeof CONTEXT_LWAN_PUBLIC);
+    hash = hash_fnv1a(hash, &CONTEXT_BOARD.clksrc, sizeof CONTEXT_BOARD.clksrc);
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        hash = hash_fnv1a(hash, &CONTEXT_RF_CHAIN[i].enable, sizeof CONTEXT_RF_CHAIN[i].enable);
+        hash = hash_fnv1a(hash, &CONTEXT_RF_CHAIN[i].freq_hz, sizeof CONTEXT_RF_CHAIN[i].freq_hz);
+        hash = hash_fnv1a(hash, &CONTEXT_RF_CHAIN[i].single_input_mode, sizeof CONTEXT_RF_CHAIN[i].single_input_mode);
+    }
+    hash = hash_fnv1a(hash, &CONTEXT_DEMOD.multisf_datarate, sizeof CONTEXT_DEMOD.multisf_datarate);
+    for (i = 0; i < (LGW_IF_CHAIN_NB + 2); i++) {
+        if (i < LGW_IF_CHAIN_NB) {
+            if_cfg = &CONTEXT_IF_CHAIN[i];
+        } else {
+            if_cfg = (i == LGW_IF_CHAIN_NB) ? &CONTEXT_LORA_SERVICE : &CONTEXT_FSK;
+        }
+        hash = hash_fnv1a(hash, &if_cfg->enable, sizeof if_cfg->enable);
+        hash = hash_fnv1a(hash, &if_cfg->rf_chain, sizeof if_cfg->rf_chain);
+        hash = hash_fnv1a(hash, &if_cfg->freq_hz, sizeof if_cfg->freq_hz);
+        hash = hash_fnv1a(hash, &if_cfg->bandwidth, sizeof if_cfg->bandwidth);
+        hash = hash_fnv1a(hash, &if_cfg->datarate, sizeof if_cfg->datarate);
+        hash = hash_fnv1a(hash, &if_cfg->sync_word_size, sizeof if_cfg->sync_word_size);
+        hash = hash_fnv1a(hash, &if_cfg->sync_word, sizeof if_cfg->sync_word);
+        hash = hash_fnv1a(hash, &if_cfg->implicit_hdr, sizeof if_cfg->implicit_hdr);
+        hash = hash_fnv1a(hash, &if_cfg->implicit_payload_length, sizeof if_cfg->implicit_payload_length);
+        hash = hash_fnv1a(hash, &if_cfg->implicit_crc_en, sizeof if_cfg->implicit_crc_en);
+        hash = hash_fnv1a(hash, &if_cfg->implicit_coderate, sizeof if_cfg->implicit_coderate);
+    }
+
+    return hash;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void snapshot_header_write(uint8_t * hdr, uint16_t image_size) {
+    uint32_t hash = context_hash();
+    uint8_t * rf;
+    int i;
+
+    memcpy(hdr, SNAPSHOT_MAGIC, 4);
+    hdr[SNAPSHOT_HDR_VERSION] = SNAPSHOT_FORMAT_VERSION;
+    hdr[SNAPSHOT_HDR_HASH + 0] = (uint8_t)(hash >> 24);
+    hdr[SNAPSHOT_HDR_HASH + 1] = (uint8_t)(hash >> 16);
+    hdr[SNAPSHOT_HDR_HASH + 2] = (uint8_t)(hash >> 8);
+    hdr[SNAPSHOT_HDR_HASH + 3] = (uint8_t)(hash >> 0);
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        rf = &hdr[SNAPSHOT_HDR_RF_CHAIN + i * SNAPSHOT_HDR_RF_CHAIN_SIZE];
+        rf[0] = (CONTEXT_RF_CHAIN[i].enable == true) ? 1 : 0;
+        rf[1] = (uint8_t)(CONTEXT_RF_CHAIN[i].freq_hz >> 24);
+        rf[2] = (uint8_t)(CONTEXT_RF_CHAIN[i].freq_hz >> 16);
+        rf[3] = (uint8_t)(CONTEXT_RF_CHAIN[i].freq_hz >> 8);
+        rf[4] = (uint8_t)(CONTEXT_RF_CHAIN[i].freq_hz >> 0);
+        rf[5] = (CONTEXT_RF_CHAIN[i].single_input_mode == true) ? 1 : 0;
+    }
+    hdr[SNAPSHOT_HDR_CLKSRC] = CONTEXT_BOARD.clksrc;
+    hdr[SNAPSHOT_HDR_IMAGE_SIZE + 0] = (uint8_t)(image_size >> 8);
+    hdr[SNAPSHOT_HDR_IMAGE_SIZE + 1] = (uint8_t)(image_size >> 0);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool snapshot_is_valid(void) {
+    uint8_t hdr[SNAPSHOT_HDR_SIZE];
+
+    if (snapshot_size < SNAPSHOT_HDR_SIZE) {
+        return false;
+    }
+
+    /* The snapshot must have been captured with the exact same configuration */
+    snapshot_header_write(hdr, snapshot_size - SNAPSHOT_HDR_SIZE);
+    if (memcmp(hdr, snapshot_blob, SNAPSHOT_HDR_SIZE) != 0) {
+        printf("WARNING: configuration snapshot does not match current configuration, ignoring it\n");
+        snapshot_size = 0;
+        return false;
+    }
+
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rssi_tcomp_set(float temperature) {
+    int i;
+    float rssi_temperature_offset;
+
+    /* Offsets only change with the temperature or the configuration */
+    if ((rssi_temperature_valid == false) || (temperature != rssi_temperature)) {
+        for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+            rssi_temperature_offset = sx1302_rssi_get_temperature_offset(&CONTEXT_RF_CHAIN[i].rssi_tcomp, temperature);
+            rssi_chain_offset[i] = CONTEXT_RF_CHAIN[i].rssi_offset + rssi_temperature_offset;
+            DEBUG_PRINTF("INFO: RSSI temperature offset for chain %d: %.3f dB (current temperature %.1f C)\n", i, rssi_temperature_offset, temperature);
+        }
+    }
+
+    rssi_temperature = temperature;
+    rssi_temperature_valid = true;
+    gettimeofday(&rssi_temperature_time, NULL);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int rssi_tcomp_update(void) {
+    int err;
+    float temperature;
+    uint32_t interval_ms;
+    struct timeval now, diff;
+
+    /* Sample the temperature again only when the interval has elapsed */
+    interval_ms = (CONTEXT_BOARD.temperature_interval_ms != 0) ? CONTEXT_BOARD.temperature_interval_ms : TEMPERATURE_INTERVAL_MS_DEFAULT;
+    if (rssi_temperature_valid == true) {
+        gettimeofday(&now, NULL);
+        TIMER_SUB(&now, &rssi_temperature_time, &diff);
+        if ((diff.tv_sec >= 0) && (((uint64_t)diff.tv_sec * 1000 + diff.tv_usec / 1000) < interval_ms)) {
+            return LGW_HAL_SUCCESS;
+        }
+    }
+
+    /* (not lgw_get_temperature(), the caller may already hold the concentrator) */
+    err = lgw_com_get_temperature(&temperature);
+    if (err != 0) {
+        printf("ERROR: failed to get current temperature\n");
+        return LGW_HAL_ERROR;
+    }
+    rssi_tcomp_set(temperature);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rssi_compensate(struct lgw_pkt_rx_view_s * p) {
+    /* Appli RSSI offset calibrated for the board, and temperature compensation */
+    p->rssic += rssi_chain_offset[p->rf_chain];
+    p->rssis += rssi_chain_offset[p->rf_chain];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool rx_dedup_check(struct lgw_pkt_rx_view_s * pkt_view, int index) {
+    struct lgw_pkt_rx_view_s * p = &pkt_view[index];
+    struct lgw_pkt_rx_view_s * q;
+    struct rx_dedup_entry_s * e;
+    struct rx_dedup_entry_s * slot = NULL;
+    uint32_t hash;
+    int i;
+
+    hash = hash_fnv1a(2166136261U, &p->crc, sizeof p->crc);
+    hash = hash_fnv1a(hash, &p->size, sizeof p->size);
+    hash = hash_fnv1a(hash, p->payload, p->size);
+    hash |= 1; /* 0 marks empty entries */
+
+    for (i = 0; i < RX_DEDUP_PROBE_NB; i++) {
+        e = &rx_dedup[(hash + i) & (RX_DEDUP_TABLE_SIZE - 1)];
+        if ((e->hash != 0) && ((p->count_us - e->count_us) > CONTEXT_RX_FILTER.dedup_window_us) && ((e->count_us - p->count_us) > CONTEXT_RX_FILTER.dedup_window_us)) {
+            e->hash = 0; /* out of the window */
+        }
+        if (e->hash == hash) {
+            /* Same frame: keep the best copy if it has not been returned yet */
+            if ((e->batch == rx_dedup_batch) && (e->index >= 0)) {
+                q = &pkt_view[e->index];
+                if ((p->snr > q->snr) || ((p->snr == q->snr) && (p->rssic > q->rssic))) {
+                    *q = *p;
+                }
+            }
+            rx_dedup_nb_drop += 1;
+            DEBUG_PRINTF("Note: duplicate frame dropped (if_chain %u, modem %u)\n", p->if_chain, p->modem_id);
+            return false;
+        }
+        if ((slot == NULL) && (e->hash == 0)) {
+            slot = e;
+        }
+    }
+
+    /* New frame, replace the first probed entry if none is free */
+    if (slot == NULL) {
+        slot = &rx_dedup[hash & (RX_DEDUP_TABLE_SIZE - 1)];
+    }
+    slot->hash = hash;
+    slot->count_us = p->count_us;
+    slot->batch = rx_dedup_batch;
+    slot->index = (int16_t)index;
+
+    return true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int receive_views(uint8_t max_pkt, struct lgw_pkt_rx_view_s * pkt_view, bool rssi_raw, uint32_t arena_size, uint8_t * nb_pkt_left) {
+    int res;
+    int i;
+    uint8_t size;
+    uint8_t nb_pkt_fetched = 0;
+    uint8_t nb_pkt_found = 0;
+
+    *nb_pkt_left = 0;
+
+    /* Get packets from SX1302, if any, and update internal counter in the same exchange */
+    /* WARNING: this needs to be called regularly by the upper layer */
+    res = sx1302_poll(&nb_pkt_fetched);
+    if (res != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to fetch packets from SX1302\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Exit now if no packet fetched */
+    if (nb_pkt_fetched == 0) {
+        return 0;
+    }
+
+    /* Refresh the RSSI temperature compensation if due */
+    if (rssi_tcomp_update() != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* Iterate on the RX buffer to get parsed packets, the ones dropped by the RX filter do not take room */
+    for (i = 0; (i < nb_pkt_fetched) && (nb_pkt_found < max_pkt); i++) {
+        /* Leave the packet in the RX buffer if its record would not fit in the arena (a full arena included) */
+        if (arena_size != RX_ARENA_NONE) {
+            if ((sx1302_parse_peek_size(&size) != LGW_REG_SUCCESS) || (LGW_PKT_RX_REC_SIZE(size) > arena_size)) {
+                break;
+            }
+        }
+
+        /* Get packet and move to next one */
+        res = sx1302_parse(&lgw_context, &pkt_view[nb_pkt_found]);
+        if (res == SX1302_PKT_FILTERED) {
+            continue;
+        } else if (res == LGW_REG_WARNING) {
+            printf("WARNING: parsing error on packet %d, discarding fetched packets\n", i);
+            *nb_pkt_left = 0;
+            return LGW_HAL_SUCCESS;
+        } else if (res == LGW_REG_ERROR) {
+            printf("ERROR: fatal parsing error on packet %d, aborting...\n", i);
+            return LGW_HAL_ERROR;
+        }
+
+        if (rssi_raw == false) {
+            rssi_compensate(&pkt_view[nb_pkt_found]);
+        }
+
+        /* Copies of the same frame received on several IF chains/modems */
+        if ((CONTEXT_RX_FILTER.enable == true) && (CONTEXT_RX_FILTER.dedup_window_us > 0) && (rx_dedup_check(pkt_view, nb_pkt_found) == false)) {
+            continue;
+        }
+        if (arena_size != RX_ARENA_NONE) {
+            arena_size -= LGW_PKT_RX_REC_SIZE(pkt_view[nb_pkt_found].size);
+        }
+        nb_pkt_found += 1;
+    }
+    *nb_pkt_left = nb_pkt_fetched - i;
+    rx_dedup_batch += 1;
+
+    DEBUG_PRINTF("INFO: nb pkt found:%u left:%u\n", nb_pkt_found, *nb_pkt_left);
+
+    return nb_pkt_found;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int receive_packets(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, uint8_t * nb_pkt_left) {
+    int i, nb_pkt;
+    struct lgw_pkt_rx_s * p;
+    const struct lgw_pkt_rx_view_s * v;
+
+    nb_pkt = receive_views(max_pkt, rx_view, false, RX_ARENA_NONE, nb_pkt_left);
+
+    /* Copy the payloads out of the RX buffer */
+    for (i = 0; i < nb_pkt; i++) {
+        p = &pkt_data[i];
+        v = &rx_view[i];
+        p->freq_hz = v->freq_hz;
+        p->freq_offset = v->freq_offset;
+        p->if_chain = v->if_chain;
+        p->status = v->status;
+        p->count_us = v->count_us;
+        p->count_us64 = v->count_us64;
+        p->rf_chain = v->rf_chain;
+        p->modem_id = v->modem_id;
+        p->modulation = v->modulation;
+        p->bandwidth = v->bandwidth;
+        p->datarate = v->datarate;
+        p->coderate = v->coderate;
+        p->rssic = v->rssic;
+        p->rssis = v->rssis;
+        p->snr = v->snr;
+        p->snr_min = v->snr_min;
+        p->snr_max = v->snr_max;
+        p->crc = v->crc;
+        p->size = v->size;
+        memcpy(p->payload, v->payload, v->size);
+        p->ftime_received = v->ftime_received;
+        p->ftime = v->ftime;
+    }
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void concentrator_lock(void) {
+    pthread_mutex_lock(&mx_concent);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void concentrator_unlock(void) {
+    pthread_mutex_unlock(&mx_concent);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rx_thread_signal(void) {
+#ifdef _WIN32
+    SetEvent(rx_thread_event);
+#else
+    uint64_t one = 1;
+    if (write(rx_thread_event, &one, sizeof one) != sizeof one) {
+        DEBUG_MSG("WARNING: failed to signal RX thread event\n");
+    }
+#endif
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void * rx_thread_loop(void * arg) {
+    int nb_pkt;
+    uint8_t nb_pkt_left;
+    uint32_t head, tail, nb_free, nb_contig;
+    uint32_t nb_enqueued;
+    static struct lgw_pkt_rx_s pkt_discard[RX_THREAD_FETCH_MAX];
+
+    (void)arg;
+
+    while (__atomic_load_n(&rx_thread_quit, __ATOMIC_ACQUIRE) == false) {
+        nb_enqueued = 0;
+        do {
+            /* Parse straight into the contiguous free slots of the ring */
+            head = rx_ring_head; /* only written by this thread */
+            tail = __atomic_load_n(&rx_ring_tail, __ATOMIC_ACQUIRE);
+            nb_free = LGW_RX_RING_SIZE - (head - tail);
+            nb_contig = LGW_RX_RING_SIZE - (head & RX_RING_MASK);
+            if (nb_contig > nb_free) {
+                nb_contig = nb_free;
+            }
+            if (nb_contig > 255) {
+                nb_contig = 255;
+            }
+
+            /* When the ring is full, keep draining the SX1302 and count the packets as dropped */
+            concentrator_lock();
+            if (nb_contig > 0) {
+                nb_pkt = receive_packets((uint8_t)nb_contig, &rx_ring[head & RX_RING_MASK], &nb_pkt_left);
+            } else {
+                nb_pkt = receive_packets(RX_THREAD_FETCH_MAX, pkt_discard, &nb_pkt_left);
+            }
+            concentrator_unlock();
+
+            __atomic_fetch_add(&rx_thread_stats.nb_poll, 1, __ATOMIC_RELAXED);
+            if (nb_pkt < 0) {
+                __atomic_fetch_add(&rx_thread_stats.nb_poll_error, 1, __ATOMIC_RELAXED);
+                break;
+            }
+            if (nb_contig > 0) {
+                __atomic_store_n(&rx_ring_head, head + nb_pkt, __ATOMIC_RELEASE);
+                __atomic_fetch_add(&rx_thread_stats.nb_pkt_received, nb_pkt, __ATOMIC_RELAXED);
+                if ((head + nb_pkt - tail) > __atomic_load_n(&rx_thread_stats.ring_peak, __ATOMIC_RELAXED)) {
+                    __atomic_store_n(&rx_thread_stats.ring_peak, head + nb_pkt - tail, __ATOMIC_RELAXED);
+                }
+                nb_enqueued += nb_pkt;
+            } else if (nb_pkt > 0) {
+                __atomic_fetch_add(&rx_thread_stats.nb_pkt_dropped, nb_pkt, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&rx_thread_stats.nb_ring_full, 1, __ATOMIC_RELAXED);
+            }
+        } while (nb_pkt_left > 0);
+
+        if (nb_enqueued > 0) {
+            rx_thread_signal();
+        }
+
+        /* Poll again right away as long as packets are coming */
+        if (nb_pkt <= 0) {
+            wait_ms(rx_thread_poll_ms);
+        }
+    }
+
+    return NULL;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t rx_wait_interval_floor(void) {
+    int i;
+    uint8_t sf;
+    uint32_t toa_us;
+    uint32_t toa_min_us = UINT32_MAX;
+
+    /* FSK packets can be as short as a few bytes: no point in waiting for LoRa ones */
+    if (CONTEXT_IF_CHAIN[9].enable == true) {
+        return RX_WAIT_INTERVAL_MIN_MS;
+    }
+
+    /* Shortest packet the multi-SF modems can receive: lowest SF enabled, 125kHz, empty payload */
+    for (i = 0; i < 8; i++) {
+        if (CONTEXT_DEMOD.multisf_datarate & (1 << i)) {
+            sf = DR_LORA_SF5 + i;
+            toa_min_us = lora_packet_time_on_air(BW_125KHZ, sf, CR_LORA_4_5, 8, false, true, 0, NULL, NULL, NULL);
+            break;
+        }
+    }
+
+    /* Shortest packet the LoRa service modem can receive */
+    if (CONTEXT_IF_CHAIN[8].enable == true) {
+        toa_us = lora_packet_time_on_air(CONTEXT_LORA_SERVICE.bandwidth, CONTEXT_LORA_SERVICE.datarate, CR_LORA_4_5, 8, false, true, 0, NULL, NULL, NULL);
+        if ((toa_us > 0) && (toa_us < toa_min_us)) {
+            toa_min_us = toa_us;
+        }
+    }
+
+    /* No packet can be received faster than that, polling more often only adds empty polls */
+    if ((toa_min_us == UINT32_MAX) || (toa_min_us < (RX_WAIT_INTERVAL_MIN_MS * 1000))) {
+        return RX_WAIT_INTERVAL_MIN_MS;
+    }
+    return (toa_min_us / 1000 < RX_WAIT_INTERVAL_MAX_MS) ? (toa_min_us / 1000) : RX_WAIT_INTERVAL_MAX_MS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint32_t rx_wait_interval_ceil(void) {
+    uint32_t ceil_ms = RX_WAIT_INTERVAL_MAX_MS;
+    uint64_t since_ms;
+    struct lgw_rx_buffer_stats_s fifo;
+
+    /* While packets keep coming, poll a few times between two arrivals, never slower than when idle */
+    if (rx_wait_last_arrival_us != 0) {
+        since_ms = (timestamp_host_us() - rx_wait_last_arrival_us) / 1000;
+        if ((since_ms < (2 * (uint64_t)rx_wait_arrival_ms)) && ((rx_wait_arrival_ms / 4) < ceil_ms)) {
+            ceil_ms = rx_wait_arrival_ms / 4;
+        }
+    }
+
+    /* Do not let the SX1302 RX buffer get more than half full between two polls */
+    if ((sx1302_rx_buffer_stats(&fifo) == LGW_REG_SUCCESS) && (fifo.fill_rate > 0)) {
+        if ((RX_WAIT_FIFO_HALF_BYTES * 1000 / fifo.fill_rate) < ceil_ms) {
+            ceil_ms = RX_WAIT_FIFO_HALF_BYTES * 1000 / fifo.fill_rate;
+        }
+    }
+
+    return ceil_ms;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int lgw_board_setconf(struct lgw_conf_board_s * conf) {
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == true) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* set internal config according to parameters */
+    CONTEXT_LWAN_PUBLIC = conf->lorawan_public;
+    CONTEXT_BOARD.clksrc = conf->clksrc;
+    CONTEXT_BOARD.no_crc_check = conf->no_crc_check;
+    CONTEXT_BOARD.temperature_interval_ms = conf->temperature_interval_ms;
+    strncpy(CONTEXT_COM_PATH, conf->com_path, sizeof CONTEXT_COM_PATH);
+    CONTEXT_COM_PATH[sizeof CONTEXT_COM_PATH - 1] = '\0'; /* ensure string termination */
+
+    DEBUG_PRINTF("Note: board configuration: com_type: %s, com_path: %s, lorawan_public:%d, clksrc:%d,\n",   "USB",
+                                                                                                                            CONTEXT_COM_PATH,
+                                                                                                                            CONTEXT_LWAN_PUBLIC,
+                                                                                                                            CONTEXT_BOARD.clksrc);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rxrf_setconf(uint8_t rf_chain, struct lgw_conf_rxrf_s * conf) {
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == true) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    if (conf->enable == false) {
+        /* nothing to do */
+        DEBUG_PRINTF("Note: rf_chain %d disabled\n", rf_chain);
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* check input range (segfault prevention) */
+    if (rf_chain >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: NOT A VALID RF_CHAIN NUMBER\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* check if the radio central frequency is valid */
+    if ((conf->freq_hz < LGW_RF_RX_FREQ_MIN) || (conf->freq_hz > LGW_RF_RX_FREQ_MAX)) {
+        DEBUG_PRINTF("ERROR: NOT A VALID RADIO CENTER FREQUENCY, PLEASE CHECK IF IT HAS BEEN GIVEN IN HZ (%u)\n", conf->freq_hz);
+        return LGW_HAL_ERROR;
+    }
+
+    /* set internal config according to parameters */
+    CONTEXT_RF_CHAIN[rf_chain].enable = conf->enable;
+    CONTEXT_RF_CHAIN[rf_chain].freq_hz = conf->freq_hz;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_offset = conf->rssi_offset;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_a = conf->rssi_tcomp.coeff_a;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_b = conf->rssi_tcomp.coeff_b;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_c = conf->rssi_tcomp.coeff_c;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_d = conf->rssi_tcomp.coeff_d;
+    CONTEXT_RF_CHAIN[rf_chain].rssi_tcomp.coeff_e = conf->rssi_tcomp.coeff_e;
+    CONTEXT_RF_CHAIN[rf_chain].tx_enable = conf->tx_enable;
+    CONTEXT_RF_CHAIN[rf_chain].single_input_mode = conf->single_input_mode;
+
+    DEBUG_PRINTF("Note: rf_chain %d configuration; en:%d freq:%d rssi_offset:%f tx_enable:%d single_input_mode:%d\n",  rf_chain,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].enable,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].freq_hz,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].rssi_offset,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].type,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].tx_enable,
+                                                                                                                CONTEXT_RF_CHAIN[rf_chain].single_input_mode);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rxif_setconf(uint8_t if_chain, struct lgw_conf_rxif_s * conf) {
+    CHECK_NULL(conf);
+
+    /* check if the concentrator is running */
+    if (CONTEXT_STARTED == true) {
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* check input range (segfault prevention) */
+    if (if_chain >= LGW_IF_CHAIN_NB) {
+        DEBUG_PRINTF("ERROR: %d NOT A VALID IF_CHAIN NUMBER\n", if_chain);
+        return LGW_HAL_ERROR;
+    }
+
+    /* if chain is disabled, don't care about most parameters */
+    if (conf->enable == false) {
+        CONTEXT_IF_CHAIN[if_chain].enable = false;
+        CONTEXT_IF_CHAIN[if_chain].freq_hz = 0;
+        DEBUG_PRINTF("Note: if_chain %d disabled\n", if_chain);
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* check 'general' parameters */
+    if (sx1302_get_ifmod_config(if_chain) == IF_UNDEFINED) {
+        DEBUG_PRINTF("ERROR: IF CHAIN %d NOT CONFIGURABLE\n", if_chain);
+    }
+    if (conf->rf_chain >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: INVALID RF_CHAIN TO ASSOCIATE WITH A LORA_STD IF CHAIN\n");
+        return LGW_HAL_ERROR;
+    }
+    if (if_range_check(conf->freq_hz, conf->bandwidth) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* check parameters according to the type of IF chain + modem,
+    fill default if necessary, and commit configuration if everything is OK */
+    switch (sx1302_get_ifmod_config(if_chain)) {
+        case IF_LORA_STD:
+            /* fill default parameters if needed */
+            if (conf->bandwidth == BW_UNDEFINED) {
+                conf->bandwidth = BW_250KHZ;
+            }
+            if (conf->datarate == DR_UNDEFINED) {
+                conf->datarate = DR_LORA_SF7;
+            }
+            /* check BW & DR */
+            if (!IS_LORA_BW(conf->bandwidth)) {
+                DEBUG_MSG("ERROR: BANDWIDTH NOT SUPPORTED BY LORA_STD IF CHAIN\n");
+                return LGW_HAL_ERROR;
+            }
+            if (!IS_LORA_DR(conf->datarate)) {
+                DEBUG_MSG("ERROR: DATARATE NOT SUPPORTED BY LORA_STD IF CHAIN\n");
+                return LGW_HAL_ERROR;
+            }
+            /* set internal configuration  */
+            CONTEXT_IF_CHAIN[if_chain].enable = conf->enable;
+            CONTEXT_IF_CHAIN[if_chain].rf_chain = conf->rf_chain;
+            CONTEXT_IF_CHAIN[if_chain].freq_hz = conf->freq_hz;
+            CONTEXT_LORA_SERVICE.bandwidth = conf->bandwidth;
+            CONTEXT_LORA_SERVICE.datarate = conf->datarate;
+            CONTEXT_LORA_SERVICE.implicit_hdr = conf->implicit_hdr;
+            CONTEXT_LORA_SERVICE.implicit_payload_length = conf->implicit_payload_length;
+            CONTEXT_LORA_SERVICE.implicit_crc_en   = conf->implicit_crc_en;
+            CONTEXT_LORA_SERVICE.implicit_coderate = conf->implicit_coderate;
+
+            DEBUG_PRINTF("Note: LoRa 'std' if_chain %d configuration; en:%d freq:%d bw:%d dr:%d\n", if_chain,
+                                                                                                    CONTEXT_IF_CHAIN[if_chain].enable,
+                                                                                                    CONTEXT_IF_CHAIN[if_chain].freq_hz,
+                                                                                                    CONTEXT_LORA_SERVICE.bandwidth,
+                                                                                                    CONTEXT_LORA_SERVICE.datarate);
+            break;
+
+        case IF_LORA_MULTI:
+            /* fill default parameters if needed */
+            if (conf->bandwidth == BW_UNDEFINED) {
+                conf->bandwidth = BW_125KHZ;
+            }
+            if (conf->datarate == DR_UNDEFINED) {
+                conf->datarate = DR_LORA_SF7;
+            }
+            /* check BW & DR */
+            if (conf->bandwidth != BW_125KHZ) {
+                DEBUG_MSG("ERROR: BANDWIDTH NOT SUPPORTED BY LORA_MULTI IF CHAIN\n");
+                return LGW_HAL_ERROR;
+            }
+            if (!IS_LORA_DR(conf->datarate)) {
+                DEBUG_MSG("ERROR: DATARATE(S) NOT SUPPORTED BY LORA_MULTI IF CHAIN\n");
+                return LGW_HAL_ERROR;
+            }
+            /* set internal configuration  */
+            CONTEXT_IF_CHAIN[if_chain].enable = conf->enable;
+            CONTEXT_IF_CHAIN[if_chain].rf_chain = conf->rf_chain;
+            CONTEXT_IF_CHAIN[if_chain].freq_hz = conf->freq_hz;
 
             DEBUG_PRINTF("Note: LoRa 'multi' if_chain %d configuration; en:%d freq:%d\n",   if_chain,
                                                                                             CONTEXT_IF_CHAIN[if_chain].enable,
                                                                                             CONTEXT_IF_CHAIN[if_chain].freq_hz);
             break;
 
-        case IF_FSK_STD:
-            /* fill default parameters if needed */
-            if (conf->bandwidth == BW_UNDEFINED) {
-                conf->bandwidth = BW_250KHZ;
+        case IF_FSK_STD:
+            /* fill default parameters if needed */
+            if (conf->bandwidth == BW_UNDEFINED) {
+                conf->bandwidth = BW_250KHZ;
+            }
+            if (conf->datarate == DR_UNDEFINED) {
+                conf->datarate = 64000; /* default datarate */
+            }
+            /* check BW & DR */
+            if(!IS_FSK_BW(conf->bandwidth)) {
+                DEBUG_MSG("ERROR: BANDWIDTH NOT SUPPORTED BY FSK IF CHAIN\n");
+                return LGW_HAL_ERROR;
+            }
+            if(!IS_FSK_DR(conf->datarate)) {
+                DEBUG_MSG("ERROR: DATARATE NOT SUPPORTED BY FSK IF CHAIN\n");
+                return LGW_HAL_ERROR;
+            }
+            /* set internal configuration  */
+            CONTEXT_IF_CHAIN[if_chain].enable = conf->enable;
+            CONTEXT_IF_CHAIN[if_chain].rf_chain = conf->rf_chain;
+            CONTEXT_IF_CHAIN[if_chain].freq_hz = conf->freq_hz;
+            CONTEXT_FSK.bandwidth = conf->bandwidth;
+            CONTEXT_FSK.datarate = conf->datarate;
+            if (conf->sync_word > 0) {
+                CONTEXT_FSK.sync_word_size = conf->sync_word_size;
+                CONTEXT_FSK.sync_word = conf->sync_word;
+            }
+            DEBUG_PRINTF("Note: FSK if_chain %d configuration; en:%d freq:%d bw:%d dr:%d (%d real dr) sync:0x%0*" PRIu64 "\n", if_chain,
+                                                                                                                        CONTEXT_IF_CHAIN[if_chain].enable,
+                                                                                                                        CONTEXT_IF_CHAIN[if_chain].freq_hz,
+                                                                                                                        CONTEXT_FSK.bandwidth,
+                                                                                                                        CONTEXT_FSK.datarate,
+                                                                                                                        LGW_XTAL_FREQU/(LGW_XTAL_FREQU/CONTEXT_FSK.datarate),
+                                                                                                                        2*CONTEXT_FSK.sync_word_size,
+                                                                                                                        CONTEXT_FSK.sync_word);
+            break;
+
+        default:
+            DEBUG_PRINTF("ERROR: IF CHAIN %d TYPE NOT SUPPORTED\n", if_chain);
+            return LGW_HAL_ERROR;
+    }
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_demod_setconf(struct lgw_conf_demod_s * conf) {
+    CHECK_NULL(conf);
+
+    CONTEXT_DEMOD.multisf_datarate = conf->multisf_datarate;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rx_filter_setconf(struct lgw_conf_rx_filter_s * conf) {
+    CHECK_NULL(conf);
+
+    if (conf->devaddr_nb > LGW_RX_FILTER_DEVADDR_NB) {
+        printf("ERROR: too many DevAddr prefixes for RX filter (%u, max %d)\n", conf->devaddr_nb, LGW_RX_FILTER_DEVADDR_NB);
+        return LGW_HAL_ERROR;
+    }
+
+    /* Only used by the packet parsing, can be changed while receiving */
+    concentrator_lock();
+    CONTEXT_RX_FILTER = *conf;
+    concentrator_unlock();
+
+    DEBUG_PRINTF("Note: RX filter configuration; en:%d crc_bad:%d no_crc:%d if:0x%03X sf:0x%02X size:%u-%u mtype:0x%02X devaddr_nb:%u\n", conf->enable, conf->drop_crc_bad, conf->drop_no_crc, conf->if_chain_mask, conf->sf_mask, conf->size_min, conf->size_max, conf->mtype_mask, conf->devaddr_nb);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_start(void) {
+    int i, err;
+    uint8_t fw_version_agc;
+    bool fw_loaded;
+    float temperature;
+    uint16_t dev_errors;
+
+    if (CONTEXT_STARTED == true) {
+        DEBUG_MSG("Note: LoRa concentrator already started, restarting it now\n");
+        if (lgw_rx_thread_stop() != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    err = lgw_connect(CONTEXT_COM_PATH);
+    if (err == LGW_REG_ERROR) {
+        DEBUG_MSG("ERROR: FAIL TO CONNECT BOARD\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Set all GPIOs to 0 */
+    err = sx1302_set_gpio(0x00);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to set all GPIOs to 0\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Get the board temperature, to reuse or refresh cached calibration results */
+    /* (also seeds the RSSI compensation for the configuration being started) */
+    rssi_temperature_valid = false;
+    err = lgw_get_temperature(&temperature);
+    if (err != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to get current temperature\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Calibrate radios */
+    err = sx1302_radio_calibrate(&CONTEXT_RF_CHAIN[0], CONTEXT_BOARD.clksrc, temperature);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: radio calibration failed\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Setup radios for RX */
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if (CONTEXT_RF_CHAIN[i].enable == true) {
+            /* Reset the radio */
+            err = sx1302_radio_reset(i);
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to reset radio %d\n", i);
+                return LGW_HAL_ERROR;
             }
-            if (conf->datarate == DR_UNDEFINED) {
-                conf->datarate = 64000; /* default datarate */
+            cal_cache_radio_reset(i);
+
+            /* Setup the radio */
+            err = sx1250_setup(i, CONTEXT_RF_CHAIN[i].freq_hz, CONTEXT_RF_CHAIN[i].single_input_mode);
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to setup radio %d\n", i);
+                return LGW_HAL_ERROR;
             }
-            /* check BW & DR */
-            if(!IS_FSK_BW(conf->bandwidth)) {
-                DEBUG_MSG("ERROR: BANDWIDTH NOT SUPPORTED BY FSK IF CHAIN\n");
+
+            /* Set radio mode */
+            err = sx1302_radio_set_mode(i);
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to set mode for radio %d\n", i);
                 return LGW_HAL_ERROR;
             }
-            if(!IS_FSK_DR(conf->datarate)) {
-                DEBUG_MSG("ERROR: DATARATE NOT SUPPORTED BY FSK IF CHAIN\n");
+        }
+    }
+
+    /* Select the radio which provides the clock to the sx1302 */
+    err = sx1302_radio_clock_select(CONTEXT_BOARD.clksrc);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to get clock from radio %u\n", CONTEXT_BOARD.clksrc);
+        return LGW_HAL_ERROR;
+    }
+
+    /* Release host control on radio (will be controlled by AGC) */
+    err = sx1302_radio_host_ctrl(false);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to release control over radios\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Restore the configuration from a matching snapshot, or run all configuration steps */
+    if (snapshot_is_valid() == true) {
+        printf("INFO: restoring SX1302 configuration from snapshot\n");
+        err = sx1302_config_restore(&snapshot_blob[SNAPSHOT_HDR_SIZE], snapshot_size - SNAPSHOT_HDR_SIZE);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to restore SX1302 configuration from snapshot\n");
+            return LGW_HAL_ERROR;
+        }
+    } else {
+        err = lgw_sx1302_configure();
+        if (err != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+
+        /* Capture the resulting configuration for a later start */
+        err = sx1302_config_snapshot(&snapshot_blob[SNAPSHOT_HDR_SIZE], sizeof snapshot_blob - SNAPSHOT_HDR_SIZE, &snapshot_size);
+        if (err != LGW_REG_SUCCESS) {
+            printf("WARNING: failed to capture SX1302 configuration snapshot\n");
+            snapshot_size = 0;
+        } else {
+            snapshot_header_write(snapshot_blob, snapshot_size);
+            snapshot_size += SNAPSHOT_HDR_SIZE;
+        }
+    }
+
+    /* Derive the per channel values used to parse received packets */
+    err = sx1302_parse_setup(&lgw_context);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to set up packet parsing\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Frames received before the restart are not duplicates anymore, filter counters start again */
+    memset(rx_dedup, 0, sizeof rx_dedup);
+    rx_dedup_nb_drop = 0;
+
+    /* Arrivals seen before the restart say nothing about the traffic to come */
+    rx_wait_interval_ms = RX_WAIT_INTERVAL_MIN_MS;
+    rx_wait_arrival_ms = RX_WAIT_INTERVAL_MAX_MS;
+    rx_wait_last_arrival_us = 0;
+
+    /* Load AGC firmware, unless it is already there from a previous start */
+    fw_version_agc = FW_VERSION_AGC_SX1250;
+    err = sx1302_agc_firmware_loaded(agc_firmware_sx1250, fw_version_agc, &fw_loaded);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to check AGC firmware\n");
+        return LGW_HAL_ERROR;
+    }
+    if (fw_loaded == false) {
+        DEBUG_MSG("Loading AGC fw for sx1250\n");
+        err = sx1302_agc_load_firmware(agc_firmware_sx1250);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to load AGC firmware for sx1250\n");
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    err = sx1302_agc_start(fw_version_agc, SX1302_AGC_RADIO_GAIN_AUTO, SX1302_AGC_RADIO_GAIN_AUTO);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to start AGC firmware\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Load ARB firmware, unless it is already there from a previous start */
+    err = sx1302_arb_firmware_loaded(arb_firmware, FW_VERSION_ARB, &fw_loaded);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to check ARB firmware\n");
+        return LGW_HAL_ERROR;
+    }
+    if (fw_loaded == false) {
+        DEBUG_MSG("Loading ARB fw\n");
+        err = sx1302_arb_load_firmware(arb_firmware);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to load ARB firmware\n");
+            return LGW_HAL_ERROR;
+        }
+    }
+    err = sx1302_arb_start(FW_VERSION_ARB);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to start ARB firmware\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* static TX configuration */
+    err = sx1302_tx_configure();
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to configure SX1302 TX path\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* enable GPS */
+    err = sx1302_gps_enable(true);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to enable GPS on sx1302\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* Connect to the external sx1261 for LBT or Spectral Scan */
+    if (CONTEXT_SX1261.enable == true) {
+        err = sx1261_load_pram();
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to patch sx1261 radio for LBT/Spectral Scan\n");
+            return LGW_HAL_ERROR;
+        }
+
+        /* The sx1261 has been reset by lgw_connect(), its calibration is always run but still recorded */
+        cal_cache_radio_reset(CAL_RADIO_SX1261);
+        err = sx1261_calibrate(CONTEXT_RF_CHAIN[0].freq_hz);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to calibrate sx1261 radio\n");
+            return LGW_HAL_ERROR;
+        }
+        err = sx1261_get_device_errors(&dev_errors);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to get sx1261 device errors\n");
+            return LGW_HAL_ERROR;
+        }
+        cal_cache_store(CAL_RADIO_SX1261, CONTEXT_RF_CHAIN[0].freq_hz, dev_errors, temperature);
+
+        err = sx1261_setup();
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to setup sx1261 radio\n");
+            return LGW_HAL_ERROR;
+        }
+    }
+
+    /* Set CONFIG_DONE GPIO to 1 (turn on the corresponding LED) */
+    err = sx1302_set_gpio(0x01);
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to set CONFIG_DONE GPIO\n");
+        return LGW_HAL_ERROR;
+    }
+
+    /* set hal state */
+    CONTEXT_STARTED = true;
+    reconf_restart_needed = false;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_stop(void) {
+    int i, x, err = LGW_HAL_SUCCESS;
+
+    if (CONTEXT_STARTED == false) {
+        DEBUG_MSG("Note: LoRa concentrator was not started...\n");
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* Stop background acquisition before the concentrator goes away */
+    x = lgw_rx_thread_stop();
+    if (x != LGW_HAL_SUCCESS) {
+        printf("WARNING: failed to stop RX thread\n");
+        err = LGW_HAL_ERROR;
+    }
+
+    /* Abort current TX if needed */
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        DEBUG_PRINTF("INFO: aborting TX on chain %u\n", i);
+        x = lgw_abort_tx(i);
+        if (x != LGW_HAL_SUCCESS) {
+            printf("WARNING: failed to get abort TX on chain %u\n", i);
+            err = LGW_HAL_ERROR;
+        }
+    }
+
+    DEBUG_MSG("INFO: Disconnecting\n");
+    x = lgw_disconnect();
+    if (x != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to disconnect concentrator\n");
+        err = LGW_HAL_ERROR;
+    }
+
+    CONTEXT_STARTED = false;
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_context(lgw_context_t * context) {
+    CHECK_NULL(context);
+
+    memcpy(context, &lgw_context, sizeof lgw_context);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reconfigure(const lgw_context_t * context) {
+    int i, err;
+    uint8_t bandwidth;
+    lgw_context_t ctx;
+    bool multisf_changed = false;
+    bool service_changed = false;
+    bool fsk_changed = false;
+    bool syncword_changed = false;
+    const struct lgw_conf_rxif_s * if_new;
+    const struct lgw_conf_rxif_s * if_cur;
+
+    CHECK_NULL(context);
+
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: concentrator is not started, use the _setconf functions and lgw_start()\n");
+        return LGW_HAL_ERROR;
+    }
+    if (rx_thread_running == true) {
+        printf("ERROR: RX thread is running, stop it before reconfiguring\n");
+        return LGW_HAL_ERROR;
+    }
+    if (reconf_restart_needed == true) {
+        printf("ERROR: a previous reconfiguration left the concentrator in an unknown state, restart it\n");
+        return LGW_RECONF_NOT_LIVE;
+    }
+
+    /* Changes which require the radios or the clock to be set up again */
+    if (context->board_cfg.clksrc != CONTEXT_BOARD.clksrc) {
+        printf("ERROR: clock source change cannot be applied live, restart the concentrator\n");
+        return LGW_RECONF_NOT_LIVE;
+    }
+    if (strncmp(context->board_cfg.com_path, CONTEXT_COM_PATH, sizeof CONTEXT_COM_PATH) != 0) {
+        printf("ERROR: COM path change cannot be applied live, restart the concentrator\n");
+        return LGW_RECONF_NOT_LIVE;
+    }
+    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
+        if ((context->rf_chain_cfg[i].enable != CONTEXT_RF_CHAIN[i].enable) ||
+            (context->rf_chain_cfg[i].freq_hz != CONTEXT_RF_CHAIN[i].freq_hz) ||
+            (context->rf_chain_cfg[i].single_input_mode != CONTEXT_RF_CHAIN[i].single_input_mode)) {
+            printf("ERROR: RF chain %d setup change cannot be applied live, restart the concentrator\n", i);
+            return LGW_RECONF_NOT_LIVE;
+        }
+    }
+    if (context->sx1261_cfg.enable != CONTEXT_SX1261.enable) {
+        printf("ERROR: SX1261 enable change cannot be applied live, restart the concentrator\n");
+        return LGW_RECONF_NOT_LIVE;
+    }
+    /* The SX1261 (SPI path, RSSI offset, LBT channels) is only set up by lgw_start() */
+    if ((strncmp(context->sx1261_cfg.spi_path, CONTEXT_SX1261.spi_path, sizeof CONTEXT_SX1261.spi_path) != 0) ||
+        (context->sx1261_cfg.rssi_offset != CONTEXT_SX1261.rssi_offset) ||
+        (memcmp(&context->sx1261_cfg.lbt_conf, &CONTEXT_SX1261.lbt_conf, sizeof CONTEXT_SX1261.lbt_conf) != 0)) {
+        printf("ERROR: SX1261 setup change cannot be applied live, restart the concentrator\n");
+        return LGW_RECONF_NOT_LIVE;
+    }
+
+    /* Find which blocks are affected */
+    for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+        if_new = &context->if_chain_cfg[i];
+        if_cur = &CONTEXT_IF_CHAIN[i];
+        if ((if_new->enable != if_cur->enable) || (if_new->rf_chain != if_cur->rf_chain) || (if_new->freq_hz != if_cur->freq_hz)) {
+            if (if_new->rf_chain >= LGW_RF_CHAIN_NB) {
+                printf("ERROR: invalid RF chain %u for IF chain %d\n", if_new->rf_chain, i);
                 return LGW_HAL_ERROR;
             }
-            /* set internal configuration  */
-            CONTEXT_IF_CHAIN[if_chain].enable = conf->enable;
-            CONTEXT_IF_CHAIN[if_chain].rf_chain = conf->rf_chain;
-            CONTEXT_IF_CHAIN[if_chain].freq_hz = conf->freq_hz;
-            CONTEXT_FSK.bandwidth = conf->bandwidth;
-            CONTEXT_FSK.datarate = conf->datarate;
-            if (conf->sync_word > 0) {
-                CONTEXT_FSK.sync_word_size = conf->sync_word_size;
-                CONTEXT_FSK.sync_word = conf->sync_word;
+            switch (sx1302_get_ifmod_config(i)) {
+                case IF_LORA_MULTI: multisf_changed = true; break;
+                case IF_LORA_STD:   service_changed = true; break;
+                case IF_FSK_STD:    fsk_changed = true; break;
+                default: break;
             }
-            DEBUG_PRINTF("Note: FSK if_chain %d configuration; en:%d freq:%d bw:%d dr:%d (%d real dr) sync:0x%0*" PRIu64 "\n", if_chain,
-                                                                                                                        CONTEXT_IF_CHAIN[if_chain].enable,
-                                                                                                                        CONTEXT_IF_CHAIN[if_chain].freq_hz,
-                                                                                                                        CONTEXT_FSK.bandwidth,
-                                                                                                                        CONTEXT_FSK.datarate,
-                                                                                                                        LGW_XTAL_FREQU/(LGW_XTAL_FREQU/CONTEXT_FSK.datarate),
-                                                                                                                        2*CONTEXT_FSK.sync_word_size,
-                                                                                                                        CONTEXT_FSK.sync_word);
-            break;
+        }
+    }
+    if (context->demod_cfg.multisf_datarate != CONTEXT_DEMOD.multisf_datarate) {
+        multisf_changed = true;
+    }
+    if_new = &context->lora_service_cfg;
+    if_cur = &CONTEXT_LORA_SERVICE;
+    if ((if_new->bandwidth != if_cur->bandwidth) || (if_new->datarate != if_cur->datarate) ||
+        (if_new->implicit_hdr != if_cur->implicit_hdr) || (if_new->implicit_payload_length != if_cur->implicit_payload_length) ||
+        (if_new->implicit_crc_en != if_cur->implicit_crc_en) || (if_new->implicit_coderate != if_cur->implicit_coderate)) {
+        if (!IS_LORA_BW(if_new->bandwidth) || !IS_LORA_DR(if_new->datarate)) {
+            printf("ERROR: invalid LoRa service channel bandwidth/datarate (%u/%u)\n", if_new->bandwidth, if_new->datarate);
+            return LGW_HAL_ERROR;
+        }
+        service_changed = true;
+    }
+    if_new = &context->fsk_cfg;
+    if_cur = &CONTEXT_FSK;
+    if ((if_new->bandwidth != if_cur->bandwidth) || (if_new->datarate != if_cur->datarate) ||
+        (if_new->sync_word_size != if_cur->sync_word_size) || (if_new->sync_word != if_cur->sync_word)) {
+        if (!IS_FSK_BW(if_new->bandwidth) || !IS_FSK_DR(if_new->datarate)) {
+            printf("ERROR: invalid FSK channel bandwidth/datarate (%u/%u)\n", if_new->bandwidth, if_new->datarate);
+            return LGW_HAL_ERROR;
+        }
+        fsk_changed = true;
+    }
+    if ((context->board_cfg.lorawan_public != CONTEXT_LWAN_PUBLIC) || (context->lora_service_cfg.datarate != CONTEXT_LORA_SERVICE.datarate)) {
+        syncword_changed = true;
+    }
 
-        default:
-            DEBUG_PRINTF("ERROR: IF CHAIN %d TYPE NOT SUPPORTED\n", if_chain);
+    /* Check the IF frequencies against the radio bandwidth, as lgw_rxif_setconf() does */
+    for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+        if (context->if_chain_cfg[i].enable == false) {
+            continue;
+        }
+        switch (sx1302_get_ifmod_config(i)) {
+            case IF_LORA_STD: bandwidth = context->lora_service_cfg.bandwidth; break;
+            case IF_FSK_STD:  bandwidth = context->fsk_cfg.bandwidth; break;
+            default:          bandwidth = BW_125KHZ; break;
+        }
+        if (if_range_check(context->if_chain_cfg[i].freq_hz, bandwidth) != LGW_HAL_SUCCESS) {
+            printf("ERROR: IF chain %d frequency %d out of the radio bandwidth\n", i, context->if_chain_cfg[i].freq_hz);
             return LGW_HAL_ERROR;
+        }
+    }
+
+    /* Write only the affected registers, the configuration is known to be valid from here */
+    ctx = *context; /* configure functions take non-const pointers */
+    err = reconfigure_write(&ctx, multisf_changed, service_changed, fsk_changed, syncword_changed);
+    if (err != LGW_HAL_SUCCESS) {
+        /* Put back the blocks which may have been partly written, so the chip matches lgw_context again */
+        ctx = lgw_context;
+        if (reconfigure_write(&ctx, multisf_changed, service_changed, fsk_changed, syncword_changed) != LGW_HAL_SUCCESS) {
+            printf("ERROR: failed to restore the previous configuration, restart the concentrator\n");
+            reconf_restart_needed = true;
+        }
+        return LGW_HAL_ERROR;
+    }
+
+    /* Commit the new configuration, host side parameters (RSSI offsets...) included */
+    memcpy(&lgw_context, context, sizeof lgw_context);
+    CONTEXT_STARTED = true;
+    sx1302_parse_setup(&lgw_context);
+    if (rssi_temperature_valid == true) {
+        rssi_temperature_valid = false; /* recompute the RSSI offsets with the new coefficients */
+        rssi_tcomp_set(rssi_temperature);
     }
 
+    /* The snapshot captured at start does not reflect this configuration anymore */
+    snapshot_size = 0;
+
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_demod_setconf(struct lgw_conf_demod_s * conf) {
-    CHECK_NULL(conf);
+int lgw_retune(uint8_t rf_chain, uint32_t freq_hz, uint32_t * outage_us) {
+    int err, err_rx;
+    uint8_t tx_status;
+    bool calibrate;
+    float temperature;
+    uint16_t dev_errors;
+    struct timeval tm_start, tm_end, tm_diff;
 
-    CONTEXT_DEMOD.multisf_datarate = conf->multisf_datarate;
+    CHECK_NULL(outage_us);
+
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: concentrator is not started, use lgw_rxrf_setconf() and lgw_start()\n");
+        return LGW_HAL_ERROR;
+    }
+    if (rx_thread_running == true) {
+        printf("ERROR: RX thread is running, stop it before retuning\n");
+        return LGW_HAL_ERROR;
+    }
+    if (rf_chain >= LGW_RF_CHAIN_NB) {
+        DEBUG_MSG("ERROR: NOT A VALID RF_CHAIN NUMBER\n");
+        return LGW_HAL_ERROR;
+    }
+    if (CONTEXT_RF_CHAIN[rf_chain].enable == false) {
+        printf("ERROR: RF chain %u is not enabled\n", rf_chain);
+        return LGW_HAL_ERROR;
+    }
+    if ((freq_hz < LGW_RF_RX_FREQ_MIN) || (freq_hz > LGW_RF_RX_FREQ_MAX)) {
+        printf("ERROR: NOT A VALID RADIO CENTER FREQUENCY, PLEASE CHECK IF IT HAS BEEN GIVEN IN HZ (%u)\n", freq_hz);
+        return LGW_HAL_ERROR;
+    }
+    if (sx1250_calibrate_band(freq_hz) < 0) {
+        printf("ERROR: frequency %u Hz is outside of the SX1250 image calibration bands\n", freq_hz);
+        return LGW_HAL_ERROR;
+    }
+
+    /* The AGC firmware drives the radio during TX, do not take it over in the middle of a transmission */
+    tx_status = sx1302_tx_status(rf_chain);
+    if ((tx_status == TX_SCHEDULED) || (tx_status == TX_EMITTING)) {
+        printf("ERROR: TX is pending on RF chain %u, retry after the transmission\n", rf_chain);
+        return LGW_HAL_ERROR;
+    }
+
+    *outage_us = 0;
+    if (freq_hz == CONTEXT_RF_CHAIN[rf_chain].freq_hz) {
+        return LGW_HAL_SUCCESS;
+    }
+
+    /* Image calibration is only valid for a band and a temperature range, skip it when both still match */
+    err = lgw_get_temperature(&temperature);
+    if (err != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to get current temperature\n");
+        return LGW_HAL_ERROR;
+    }
+    calibrate = !cal_cache_match(rf_chain, freq_hz, temperature, true);
+
+    gettimeofday(&tm_start, NULL);
+
+    /* Pause the demodulators, then take the radio from the AGC */
+    err = sx1302_rx_enable(false);
+    if (err == LGW_REG_SUCCESS) {
+        err = sx1302_radio_host_ctrl(true);
+    }
+    if (err == LGW_REG_SUCCESS) {
+        err = sx1250_set_rx_freq(rf_chain, freq_hz, calibrate);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to retune radio %u to %u Hz\n", rf_chain, freq_hz);
+            cal_cache_radio_reset(rf_chain);
+        } else if (calibrate == true) {
+            err = sx1250_get_device_errors(rf_chain, &dev_errors);
+            if (err == LGW_REG_SUCCESS) {
+                cal_cache_store(rf_chain, freq_hz, dev_errors, temperature);
+            }
+        }
+        /* Give the radio back to the AGC in any case */
+        err |= sx1302_radio_host_ctrl(false);
+    }
+    if ((err == LGW_REG_SUCCESS) && (rf_chain == 0)) {
+        err = sx1302_lora_freq_to_time_configure(freq_hz, CONTEXT_LORA_SERVICE.bandwidth);
+    }
+
+    /* Resume reception even if something went wrong, to be on the previous or new frequency */
+    err_rx = sx1302_rx_enable(true);
+
+    gettimeofday(&tm_end, NULL);
+    TIMER_SUB(&tm_end, &tm_start, &tm_diff);
+    *outage_us = (uint32_t)(tm_diff.tv_sec * 1000000UL + tm_diff.tv_usec);
+
+    if ((err != LGW_REG_SUCCESS) || (err_rx != LGW_REG_SUCCESS)) {
+        printf("ERROR: RF chain %u retune failed after %u us of RX outage\n", rf_chain, *outage_us);
+        return LGW_HAL_ERROR;
+    }
+
+    printf("INFO: RF chain %u retuned from %u Hz to %u Hz (%s), RX outage: %u us\n", rf_chain, CONTEXT_RF_CHAIN[rf_chain].freq_hz, freq_hz,
+                                                                                    (calibrate == true) ? "image calibrated" : "same band", *outage_us);
+
+    /* Packets are now reported relative to the new frequency */
+    CONTEXT_RF_CHAIN[rf_chain].freq_hz = freq_hz;
+    sx1302_parse_setup(&lgw_context);
+    snapshot_size = 0;
 
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_start(void) {
-    int i, err;
-    uint8_t fw_version_agc;
+int lgw_snapshot_get(uint8_t * blob, uint16_t max_size, uint16_t * size) {
+    CHECK_NULL(blob);
+    CHECK_NULL(size);
+
+    if ((CONTEXT_STARTED == false) || (snapshot_size == 0)) {
+        printf("ERROR: no configuration snapshot available, concentrator must be started first\n");
+        return LGW_HAL_ERROR;
+    }
+    if (max_size < snapshot_size) {
+        printf("ERROR: configuration snapshot does not fit in %u bytes (%u)\n", max_size, snapshot_size);
+        return LGW_HAL_ERROR;
+    }
+
+    memcpy(blob, snapshot_blob, snapshot_size);
+    *size = snapshot_size;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_snapshot_set(const uint8_t * blob, uint16_t size) {
+    CHECK_NULL(blob);
+
+    /* check if the concentrator is running */
     if (CONTEXT_STARTED == true) {
-        DEBUG_MSG("Note: LoRa concentrator already started, restarting it now\n");
+        DEBUG_MSG("ERROR: CONCENTRATOR IS RUNNING, STOP IT BEFORE TOUCHING CONFIGURATION\n");
+        return LGW_HAL_ERROR;
     }
 
-    err = lgw_connect(CONTEXT_COM_PATH);
-    if (err == LGW_REG_ERROR) {
-        DEBUG_MSG("ERROR: FAIL TO CONNECT BOARD\n");
+    if ((size < SNAPSHOT_HDR_SIZE) || (size > sizeof snapshot_blob) || (memcmp(blob, SNAPSHOT_MAGIC, 4) != 0)) {
+        printf("ERROR: invalid configuration snapshot\n");
+        return LGW_HAL_ERROR;
+    }
+    if (blob[SNAPSHOT_HDR_VERSION] != SNAPSHOT_FORMAT_VERSION) {
+        printf("ERROR: unsupported configuration snapshot format (%u)\n", blob[SNAPSHOT_HDR_VERSION]);
         return LGW_HAL_ERROR;
     }
 
-    /* Set all GPIOs to 0 */
-    err = sx1302_set_gpio(0x00);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to set all GPIOs to 0\n");
+    /* Checked against the configuration when starting */
+    memcpy(snapshot_blob, blob, size);
+    snapshot_size = size;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_cal_cache_get(uint8_t * blob, uint16_t max_size, uint16_t * size) {
+    CHECK_NULL(blob);
+    CHECK_NULL(size);
+
+    if (cal_cache_get(blob, max_size, size) != LGW_REG_SUCCESS) {
         return LGW_HAL_ERROR;
     }
 
-    /* Calibrate radios */
-    err = sx1302_radio_calibrate(&CONTEXT_RF_CHAIN[0], CONTEXT_BOARD.clksrc);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: radio calibration failed\n");
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_cal_cache_set(const uint8_t * blob, uint16_t size) {
+    CHECK_NULL(blob);
+
+    if (CONTEXT_STARTED == true) {
+        printf("ERROR: concentrator is running, set the calibration cache before lgw_start()\n");
         return LGW_HAL_ERROR;
     }
 
-    /* Setup radios for RX */
-    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
-        if (CONTEXT_RF_CHAIN[i].enable == true) {
-            /* Reset the radio */
-            err = sx1302_radio_reset(i);
-            if (err != LGW_REG_SUCCESS) {
-                printf("ERROR: failed to reset radio %d\n", i);
-                return LGW_HAL_ERROR;
-            }
+    if (cal_cache_set(blob, size) != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
 
-            /* Setup the radio */
-            err = sx1250_setup(i, CONTEXT_RF_CHAIN[i].freq_hz, CONTEXT_RF_CHAIN[i].single_input_mode);
-            if (err != LGW_REG_SUCCESS) {
-                printf("ERROR: failed to setup radio %d\n", i);
-                return LGW_HAL_ERROR;
-            }
+    return LGW_HAL_SUCCESS;
+}
 
-            /* Set radio mode */
-            err = sx1302_radio_set_mode(i);
-            if (err != LGW_REG_SUCCESS) {
-                printf("ERROR: failed to set mode for radio %d\n", i);
-                return LGW_HAL_ERROR;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
+    int nb_pkt;
+    uint8_t nb_pkt_left;
+
+    if (rx_thread_running == true) {
+        printf("ERROR: RX thread is running, use lgw_rx_dequeue() to get packets\n");
+        return LGW_HAL_ERROR;
+    }
+
+    nb_pkt = receive_packets(max_pkt, pkt_data, &nb_pkt_left);
+    if (nb_pkt_left > 0) {
+        printf("WARNING: not enough space allocated, fetched %d packet(s), %d will be left in RX buffer\n", nb_pkt + nb_pkt_left, nb_pkt_left);
+    }
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_wait(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data, uint32_t timeout_ms) {
+    int nb_pkt;
+    uint32_t elapsed_ms, floor_ms, ceil_ms, arrival_ms;
+    uint64_t start_us, now_us;
+
+    CHECK_NULL(pkt_data);
+
+    floor_ms = rx_wait_interval_floor();
+    start_us = timestamp_host_us();
+    while (1) {
+        nb_pkt = lgw_receive(max_pkt, pkt_data);
+        now_us = timestamp_host_us();
+        if (nb_pkt > 0) {
+            /* Traffic: average time between arrivals (from the second one on), and poll tightly again */
+            if (rx_wait_last_arrival_us != 0) {
+                arrival_ms = ((now_us - rx_wait_last_arrival_us) > 60000000) ? 60000 : (uint32_t)((now_us - rx_wait_last_arrival_us) / 1000);
+                rx_wait_arrival_ms = (rx_wait_arrival_ms * 7 + arrival_ms) / 8;
             }
+            rx_wait_last_arrival_us = now_us;
+            rx_wait_interval_ms = floor_ms;
+        }
+        if (nb_pkt != 0) {
+            return nb_pkt;
+        }
+
+        elapsed_ms = (uint32_t)((now_us - start_us) / 1000);
+        if (elapsed_ms >= timeout_ms) {
+            return 0;
+        }
+
+        /* Idle: back off, within the bounds set by the time on air, the recent arrivals and the RX buffer fill rate */
+        ceil_ms = rx_wait_interval_ceil();
+        if (ceil_ms < floor_ms) {
+            ceil_ms = floor_ms;
         }
+        rx_wait_interval_ms = (rx_wait_interval_ms < floor_ms) ? floor_ms : rx_wait_interval_ms * 2;
+        if (rx_wait_interval_ms > ceil_ms) {
+            rx_wait_interval_ms = ceil_ms;
+        }
+
+        wait_ms((rx_wait_interval_ms < (timeout_ms - elapsed_ms)) ? rx_wait_interval_ms : (timeout_ms - elapsed_ms));
     }
+}
 
-    /* Select the radio which provides the clock to the sx1302 */
-    err = sx1302_radio_clock_select(CONTEXT_BOARD.clksrc);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to get clock from radio %u\n", CONTEXT_BOARD.clksrc);
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_batch(struct lgw_pkt_rx_batch_s * batch) {
+    int i, nb_pkt;
+    uint8_t max_pkt;
+    uint8_t nb_pkt_left;
+    uint32_t offset;
+    float rssi_offset[UINT8_MAX];
+
+    CHECK_NULL(batch);
+
+    if (rx_thread_running == true) {
+        printf("ERROR: RX thread is running, use lgw_rx_dequeue() to get packets\n");
         return LGW_HAL_ERROR;
     }
-
-    /* Release host control on radio (will be controlled by AGC) */
-    err = sx1302_radio_host_ctrl(false);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to release control over radios\n");
+    if ((batch->payload != NULL) && (batch->payload_offset == NULL)) {
+        printf("ERROR: payload arena given without offsets\n");
         return LGW_HAL_ERROR;
     }
 
-    /* Basic initialization of the sx1302 */
-    err = sx1302_init();
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to initialize SX1302\n");
+    /* Only fetch as many packets as the payload arena can always hold */
+    max_pkt = batch->max_pkt;
+    if ((batch->payload != NULL) && ((batch->payload_size / 255) < max_pkt)) {
+        max_pkt = (uint8_t)(batch->payload_size / 255);
+    }
+
+    nb_pkt = receive_views(max_pkt, rx_view, true, RX_ARENA_NONE, &nb_pkt_left);
+    if (nb_pkt_left > 0) {
+        printf("WARNING: not enough space allocated, fetched %d packet(s), %d will be left in RX buffer\n", nb_pkt + nb_pkt_left, nb_pkt_left);
+    }
+    if (nb_pkt <= 0) {
+        return nb_pkt;
+    }
+
+    /* Scatter the metadata to the columns requested */
+#define BATCH_COLUMN(col) if (batch->col != NULL) { for (i = 0; i < nb_pkt; i++) { batch->col[i] = rx_view[i].col; } }
+    BATCH_COLUMN(count_us);
+    BATCH_COLUMN(count_us64);
+    BATCH_COLUMN(freq_hz);
+    BATCH_COLUMN(freq_offset);
+    BATCH_COLUMN(if_chain);
+    BATCH_COLUMN(rf_chain);
+    BATCH_COLUMN(modem_id);
+    BATCH_COLUMN(status);
+    BATCH_COLUMN(modulation);
+    BATCH_COLUMN(bandwidth);
+    BATCH_COLUMN(datarate);
+    BATCH_COLUMN(coderate);
+    BATCH_COLUMN(snr);
+    BATCH_COLUMN(snr_min);
+    BATCH_COLUMN(snr_max);
+    BATCH_COLUMN(crc);
+    BATCH_COLUMN(size);
+    BATCH_COLUMN(ftime_received);
+    BATCH_COLUMN(ftime);
+#undef BATCH_COLUMN
+
+    /* RSSI offset (board + temperature) applied to the whole columns */
+    for (i = 0; i < nb_pkt; i++) {
+        rssi_offset[i] = rssi_chain_offset[rx_view[i].rf_chain];
+    }
+    if (batch->rssic != NULL) {
+        for (i = 0; i < nb_pkt; i++) {
+            batch->rssic[i] = rx_view[i].rssic + rssi_offset[i];
+        }
+    }
+    if (batch->rssis != NULL) {
+        for (i = 0; i < nb_pkt; i++) {
+            batch->rssis[i] = rx_view[i].rssis + rssi_offset[i];
+        }
+    }
+
+    /* Pack the payloads back to back in the arena */
+    if (batch->payload != NULL) {
+        offset = 0;
+        for (i = 0; i < nb_pkt; i++) {
+            batch->payload_offset[i] = offset;
+            memcpy(&batch->payload[offset], rx_view[i].payload, rx_view[i].size);
+            offset += rx_view[i].size;
+        }
+        batch->payload_offset[nb_pkt] = offset;
+    }
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_compact(uint8_t max_pkt, uint8_t * arena, uint32_t arena_size, uint32_t * arena_used) {
+    int i, nb_pkt;
+    uint8_t nb_pkt_left;
+    uint32_t offset;
+    struct lgw_pkt_rx_rec_s * r;
+    const struct lgw_pkt_rx_view_s * v;
+
+    CHECK_NULL(arena);
+    CHECK_NULL(arena_used);
+
+    *arena_used = 0;
+
+    if (rx_thread_running == true) {
+        printf("ERROR: RX thread is running, use lgw_rx_dequeue() to get packets\n");
+        return LGW_HAL_ERROR;
+    }
+    if (((uintptr_t)arena & 7) != 0) {
+        printf("ERROR: packet record arena must be 8-byte aligned\n");
         return LGW_HAL_ERROR;
     }
+    if (arena_size < LGW_PKT_RX_REC_SIZE(0)) {
+        return 0;
+    }
+    if (arena_size == RX_ARENA_NONE) {
+        arena_size -= 1; /* RX_ARENA_NONE would turn the arena size check off */
+    }
 
-    /* Configure PA/LNA LUTs */
-    err = sx1302_pa_lna_lut_configure();
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to configure SX1302 PA/LNA LUT\n");
+    nb_pkt = receive_views(max_pkt, rx_view, false, arena_size, &nb_pkt_left);
+    if (nb_pkt < 0) {
         return LGW_HAL_ERROR;
     }
+    if (nb_pkt_left > 0) {
+        DEBUG_PRINTF("Note: fetched %d packet(s), %d left in RX buffer for the next call\n", nb_pkt + nb_pkt_left, nb_pkt_left);
+    }
 
-    /* Configure Radio FE */
-    err = sx1302_radio_fe_configure();
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to configure SX1302 radio frontend\n");
+    /* Records back to back, each one sized after its payload */
+    offset = 0;
+    for (i = 0; i < nb_pkt; i++) {
+        v = &rx_view[i];
+        if ((arena_size - offset) < LGW_PKT_RX_REC_SIZE(v->size)) {
+            printf("ERROR: packet record %d does not fit in the arena, %d packet(s) lost\n", i, nb_pkt - i);
+            break;
+        }
+        r = (struct lgw_pkt_rx_rec_s *)&arena[offset];
+        r->count_us64 = v->count_us64;
+        r->count_us = v->count_us;
+        r->freq_hz = v->freq_hz;
+        r->freq_offset = v->freq_offset;
+        r->datarate = v->datarate;
+        r->ftime = v->ftime;
+        r->rssic = v->rssic;
+        r->rssis = v->rssis;
+        r->snr = v->snr;
+        r->snr_min = v->snr_min;
+        r->snr_max = v->snr_max;
+        r->crc = v->crc;
+        r->size = v->size;
+        r->rec_size = LGW_PKT_RX_REC_SIZE(v->size);
+        r->if_chain = v->if_chain;
+        r->status = v->status;
+        r->rf_chain = v->rf_chain;
+        r->modem_id = v->modem_id;
+        r->modulation = v->modulation;
+        r->bandwidth = v->bandwidth;
+        r->coderate = v->coderate;
+        r->ftime_received = v->ftime_received;
+        memcpy(r->payload, v->payload, v->size);
+        offset += r->rec_size;
+    }
+    *arena_used = offset;
+
+    return i;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_pkt_rx_rec_unpack(const struct lgw_pkt_rx_rec_s * rec, struct lgw_pkt_rx_s * pkt) {
+    CHECK_NULL(rec);
+    CHECK_NULL(pkt);
+
+    pkt->freq_hz = rec->freq_hz;
+    pkt->freq_offset = rec->freq_offset;
+    pkt->if_chain = rec->if_chain;
+    pkt->status = rec->status;
+    pkt->count_us = rec->count_us;
+    pkt->count_us64 = rec->count_us64;
+    pkt->rf_chain = rec->rf_chain;
+    pkt->modem_id = rec->modem_id;
+    pkt->modulation = rec->modulation;
+    pkt->bandwidth = rec->bandwidth;
+    pkt->datarate = rec->datarate;
+    pkt->coderate = rec->coderate;
+    pkt->rssic = rec->rssic;
+    pkt->rssis = rec->rssis;
+    pkt->snr = rec->snr;
+    pkt->snr_min = rec->snr_min;
+    pkt->snr_max = rec->snr_max;
+    pkt->crc = rec->crc;
+    pkt->size = rec->size;
+    memcpy(pkt->payload, rec->payload, rec->size);
+    pkt->ftime_received = rec->ftime_received;
+    pkt->ftime = rec->ftime;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_view(uint8_t max_pkt, struct lgw_pkt_rx_view_s * pkt_view) {
+    int nb_pkt;
+    uint8_t nb_pkt_left;
+
+    CHECK_NULL(pkt_view);
+
+    if (rx_thread_running == true) {
+        printf("ERROR: RX thread is running, use lgw_rx_dequeue() to get packets\n");
         return LGW_HAL_ERROR;
     }
 
-    /* Configure the Channelizer */
-    err = sx1302_channelizer_configure(CONTEXT_IF_CHAIN, false);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to configure SX1302 channelizer\n");
+    nb_pkt = receive_views(max_pkt, pkt_view, false, RX_ARENA_NONE, &nb_pkt_left);
+    if (nb_pkt_left > 0) {
+        printf("WARNING: not enough space allocated, fetched %d packet(s), %d will be left in RX buffer\n", nb_pkt + nb_pkt_left, nb_pkt_left);
+    }
+
+    return nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_receive_cb(lgw_rx_cb_t cb, void * arg) {
+    int res;
+    int i;
+    int nb_pkt_found = 0;
+    uint8_t nb_pkt_fetched = 0;
+    struct lgw_pkt_rx_view_s pkt_view;
+
+    CHECK_NULL(cb);
+
+    if (rx_thread_running == true) {
+        printf("ERROR: RX thread is running, use lgw_rx_dequeue() to get packets\n");
         return LGW_HAL_ERROR;
     }
 
-    /* configure LoRa 'multi-sf' modems */
-    err = sx1302_lora_correlator_configure(CONTEXT_IF_CHAIN, &(CONTEXT_DEMOD));
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to configure SX1302 LoRa modem correlators\n");
+    /* One fetch reads all the bytes available in the SX1302 RX buffer */
+    res = sx1302_poll(&nb_pkt_fetched);
+    if (res != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to fetch packets from SX1302\n");
         return LGW_HAL_ERROR;
     }
-    err = sx1302_lora_modem_configure(CONTEXT_RF_CHAIN[0].freq_hz);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to configure SX1302 LoRa modems\n");
+    if (nb_pkt_fetched == 0) {
+        return 0;
+    }
+
+    if (rssi_tcomp_update() != LGW_HAL_SUCCESS) {
         return LGW_HAL_ERROR;
     }
 
-    /* configure LoRa 'single-sf' modem */
-    if (CONTEXT_IF_CHAIN[8].enable == true) {
-        err = sx1302_lora_service_correlator_configure(&(CONTEXT_LORA_SERVICE));
-        if (err != LGW_REG_SUCCESS) {
-            printf("ERROR: failed to configure SX1302 LoRa Service modem correlators\n");
-            return LGW_HAL_ERROR;
-        }
-        err = sx1302_lora_service_modem_configure(&(CONTEXT_LORA_SERVICE), CONTEXT_RF_CHAIN[0].freq_hz);
-        if (err != LGW_REG_SUCCESS) {
-            printf("ERROR: failed to configure SX1302 LoRa Service modem\n");
+    /* Hand over every fetched packet, nothing is left for a later call */
+    for (i = 0; i < nb_pkt_fetched; i++) {
+        res = sx1302_parse(&lgw_context, &pkt_view);
+        if (res == SX1302_PKT_FILTERED) {
+            continue;
+        } else if (res == LGW_REG_WARNING) {
+            printf("WARNING: parsing error on packet %d, discarding fetched packets\n", i);
+            break;
+        } else if (res == LGW_REG_ERROR) {
+            printf("ERROR: fatal parsing error on packet %d, aborting...\n", i);
             return LGW_HAL_ERROR;
         }
-    }
 
-    /* configure FSK modem */
-    if (CONTEXT_IF_CHAIN[9].enable == true) {
-        err = sx1302_fsk_configure(&(CONTEXT_FSK));
-        if (err != LGW_REG_SUCCESS) {
-            printf("ERROR: failed to configure SX1302 FSK modem\n");
-            return LGW_HAL_ERROR;
+        rssi_compensate(&pkt_view);
+
+        /* Packets are handed over one by one: later copies of a frame are dropped */
+        if ((CONTEXT_RX_FILTER.enable == true) && (CONTEXT_RX_FILTER.dedup_window_us > 0)) {
+            rx_dedup_batch += 1;
+            if (rx_dedup_check(&pkt_view, 0) == false) {
+                continue;
+            }
         }
-    }
 
-    /* configure syncword */
-    err = sx1302_lora_syncword(CONTEXT_LWAN_PUBLIC, CONTEXT_LORA_SERVICE.datarate);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to configure SX1302 LoRa syncword\n");
-        return LGW_HAL_ERROR;
+        cb(&pkt_view, arg);
+        nb_pkt_found += 1;
     }
 
-    /* enable demodulators - to be done before starting AGC/ARB */
-    err = sx1302_modem_enable();
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to enable SX1302 modems\n");
-        return LGW_HAL_ERROR;
-    }
+    return nb_pkt_found;
+}
 
-    /* Load AGC firmware */
-    DEBUG_MSG("Loading AGC fw for sx1250\n");
-    err = sx1302_agc_load_firmware(agc_firmware_sx1250);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to load AGC firmware for sx1250\n");
-        return LGW_HAL_ERROR;
-    }
-    fw_version_agc = FW_VERSION_AGC_SX1250;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    err = sx1302_agc_start(fw_version_agc, SX1302_AGC_RADIO_GAIN_AUTO, SX1302_AGC_RADIO_GAIN_AUTO);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to start AGC firmware\n");
+int lgw_get_rx_buffer_stats(struct lgw_rx_buffer_stats_s * stats) {
+    int err;
+
+    CHECK_NULL(stats);
+
+    concentrator_lock();
+    err = sx1302_rx_buffer_stats(stats);
+    concentrator_unlock();
+
+    return (err == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_rx_filter_stats(struct lgw_rx_filter_stats_s * stats) {
+    int err;
+
+    CHECK_NULL(stats);
+
+    concentrator_lock();
+    err = sx1302_rx_filter_stats(stats);
+    stats->nb_pkt_accepted -= rx_dedup_nb_drop;
+    stats->nb_drop_duplicate = rx_dedup_nb_drop;
+    concentrator_unlock();
+
+    return (err == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_rx_thread_start(uint32_t poll_interval_ms) {
+    int err;
+
+    if (CONTEXT_STARTED == false) {
+        printf("ERROR: concentrator is not started, start it before the RX thread\n");
         return LGW_HAL_ERROR;
     }
+    if (rx_thread_running == true) {
+        DEBUG_MSG("Note: RX thread already running\n");
+        return LGW_HAL_SUCCESS;
+    }
 
-    /* Load ARB firmware */
-    DEBUG_MSG("Loading ARB fw\n");
-    err = sx1302_arb_load_firmware(arb_firmware);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to load ARB firmware\n");
+#ifdef _WIN32
+    rx_thread_event = CreateEvent(NULL, FALSE, FALSE, NULL); /* auto-reset */
+    if (rx_thread_event == NULL) {
+        printf("ERROR: failed to create RX thread event\n");
         return LGW_HAL_ERROR;
     }
-    err = sx1302_arb_start(FW_VERSION_ARB);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to start ARB firmware\n");
+#else
+    rx_thread_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (rx_thread_event < 0) {
+        printf("ERROR: failed to create RX thread eventfd\n");
         return LGW_HAL_ERROR;
     }
+#endif
 
-    /* static TX configuration */
-    err = sx1302_tx_configure();
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to configure SX1302 TX path\n");
+    rx_ring_head = 0;
+    rx_ring_tail = 0;
+    memset(&rx_thread_stats, 0, sizeof rx_thread_stats);
+    rx_thread_poll_ms = poll_interval_ms;
+    rx_thread_quit = false;
+
+    err = pthread_create(&rx_thread, NULL, rx_thread_loop, NULL);
+    if (err != 0) {
+        printf("ERROR: failed to create RX thread (%d)\n", err);
+#ifdef _WIN32
+        CloseHandle(rx_thread_event);
+        rx_thread_event = NULL;
+#else
+        close(rx_thread_event);
+        rx_thread_event = -1;
+#endif
         return LGW_HAL_ERROR;
     }
+    rx_thread_running = true;
 
-    /* enable GPS */
-    err = sx1302_gps_enable(true);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to enable GPS on sx1302\n");
-        return LGW_HAL_ERROR;
-    }
+    return LGW_HAL_SUCCESS;
+}
 
-    /* Connect to the external sx1261 for LBT or Spectral Scan */
-    if (CONTEXT_SX1261.enable == true) {
-        err = sx1261_load_pram();
-        if (err != LGW_REG_SUCCESS) {
-            printf("ERROR: failed to patch sx1261 radio for LBT/Spectral Scan\n");
-            return LGW_HAL_ERROR;
-        }
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-        err = sx1261_calibrate(CONTEXT_RF_CHAIN[0].freq_hz);
-        if (err != LGW_REG_SUCCESS) {
-            printf("ERROR: failed to calibrate sx1261 radio\n");
-            return LGW_HAL_ERROR;
-        }
+int lgw_rx_thread_stop(void) {
+    int err;
 
-        err = sx1261_setup();
-        if (err != LGW_REG_SUCCESS) {
-            printf("ERROR: failed to setup sx1261 radio\n");
-            return LGW_HAL_ERROR;
-        }
+    if (rx_thread_running == false) {
+        return LGW_HAL_SUCCESS;
     }
 
-    /* Set CONFIG_DONE GPIO to 1 (turn on the corresponding LED) */
-    err = sx1302_set_gpio(0x01);
-    if (err != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to set CONFIG_DONE GPIO\n");
+    __atomic_store_n(&rx_thread_quit, true, __ATOMIC_RELEASE);
+    err = pthread_join(rx_thread, NULL);
+    if (err != 0) {
+        printf("ERROR: failed to join RX thread (%d)\n", err);
         return LGW_HAL_ERROR;
     }
+    rx_thread_running = false;
 
-    /* set hal state */
-    CONTEXT_STARTED = true;
+#ifdef _WIN32
+    CloseHandle(rx_thread_event);
+    rx_thread_event = NULL;
+#else
+    close(rx_thread_event);
+    rx_thread_event = -1;
+#endif
+
+    DEBUG_PRINTF("INFO: RX thread stopped, %u packet(s) received, %u dropped\n", rx_thread_stats.nb_pkt_received, rx_thread_stats.nb_pkt_dropped);
 
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_stop(void) {
-    int i, x, err = LGW_HAL_SUCCESS;
+int lgw_rx_dequeue(uint8_t max_pkt, struct lgw_pkt_rx_s * pkt_data) {
+    uint32_t head, tail, i, nb_pkt;
 
-    if (CONTEXT_STARTED == false) {
-        DEBUG_MSG("Note: LoRa concentrator was not started...\n");
-        return LGW_HAL_SUCCESS;
-    }
+    CHECK_NULL(pkt_data);
 
-    /* Abort current TX if needed */
-    for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
-        DEBUG_PRINTF("INFO: aborting TX on chain %u\n", i);
-        x = lgw_abort_tx(i);
-        if (x != LGW_HAL_SUCCESS) {
-            printf("WARNING: failed to get abort TX on chain %u\n", i);
-            err = LGW_HAL_ERROR;
-        }
+    tail = rx_ring_tail; /* only written by the consumer */
+    head = __atomic_load_n(&rx_ring_head, __ATOMIC_ACQUIRE);
+    nb_pkt = head - tail;
+    if (nb_pkt > max_pkt) {
+        nb_pkt = max_pkt;
     }
 
-    DEBUG_MSG("INFO: Disconnecting\n");
-    x = lgw_disconnect();
-    if (x != LGW_HAL_SUCCESS) {
-        printf("ERROR: failed to disconnect concentrator\n");
-        err = LGW_HAL_ERROR;
+    for (i = 0; i < nb_pkt; i++) {
+        memcpy(&pkt_data[i], &rx_ring[(tail + i) & RX_RING_MASK], sizeof(struct lgw_pkt_rx_s));
     }
+    __atomic_store_n(&rx_ring_tail, tail + nb_pkt, __ATOMIC_RELEASE);
 
-    CONTEXT_STARTED = false;
-
-    return err;
+    return (int)nb_pkt;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int lgw_receive(uint8_t max_pkt, struct lgw_pkt_rx_s *pkt_data) {
-    int res;
-    uint8_t nb_pkt_fetched = 0;
-    uint8_t nb_pkt_found = 0;
-    uint8_t nb_pkt_left = 0;
-    float current_temperature = 0.0, rssi_temperature_offset = 0.0;
+int lgw_rx_thread_wait(uint32_t timeout_ms) {
+    uint32_t nb_pkt;
+#ifndef _WIN32
+    struct pollfd pfd;
+    uint64_t val;
+#endif
 
-    /* Get packets from SX1302, if any */
-    res = sx1302_fetch(&nb_pkt_fetched);
-    if (res != LGW_REG_SUCCESS) {
-        printf("ERROR: failed to fetch packets from SX1302\n");
+    if (rx_thread_running == false) {
+        printf("ERROR: RX thread is not running\n");
         return LGW_HAL_ERROR;
     }
 
-    /* Update internal counter */
-    /* WARNING: this needs to be called regularly by the upper layer */
-    res = sx1302_update();
-    if (res != LGW_REG_SUCCESS) {
-        return LGW_HAL_ERROR;
+    nb_pkt = __atomic_load_n(&rx_ring_head, __ATOMIC_ACQUIRE) - rx_ring_tail;
+    if (nb_pkt > 0) {
+        return (int)nb_pkt;
     }
 
-    /* Exit now if no packet fetched */
-    if (nb_pkt_fetched == 0) {
-        return 0;
-    }
-    if (nb_pkt_fetched > max_pkt) {
-        nb_pkt_left = nb_pkt_fetched - max_pkt;
-        printf("WARNING: not enough space allocated, fetched %d packet(s), %d will be left in RX buffer\n", nb_pkt_fetched, nb_pkt_left);
+#ifdef _WIN32
+    if (WaitForSingleObject(rx_thread_event, timeout_ms) == WAIT_FAILED) {
+        printf("ERROR: failed to wait for RX thread event\n");
+        return LGW_HAL_ERROR;
     }
-
-    /* Apply RSSI temperature compensation */
-    res = lgw_get_temperature(&current_temperature);
-    if (res != 0) {
-        printf("ERROR: failed to get current temperature\n");
+#else
+    pfd.fd = rx_thread_event;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, (timeout_ms > INT32_MAX) ? -1 : (int)timeout_ms) < 0) {
+        printf("ERROR: failed to wait for RX thread eventfd\n");
         return LGW_HAL_ERROR;
     }
+    /* Clear the event counter, the read fails with EAGAIN on timeout */
+    if (read(rx_thread_event, &val, sizeof val) < 0) {
+        DEBUG_MSG("INFO: no RX thread event\n");
+    }
+#endif
 
-    /* Iterate on the RX buffer to get parsed packets */
-    for (nb_pkt_found = 0; nb_pkt_found < ((nb_pkt_fetched <= max_pkt) ? nb_pkt_fetched : max_pkt); nb_pkt_found++) {
-        /* Get packet and move to next one */
-        res = sx1302_parse(&lgw_context, &pkt_data[nb_pkt_found]);
-        if (res == LGW_REG_WARNING) {
-            printf("WARNING: parsing error on packet %d, discarding fetched packets\n", nb_pkt_found);
-            return LGW_HAL_SUCCESS;
-        } else if (res == LGW_REG_ERROR) {
-            printf("ERROR: fatal parsing error on packet %d, aborting...\n", nb_pkt_found);
-            return LGW_HAL_ERROR;
-        }
+    return (int)(__atomic_load_n(&rx_ring_head, __ATOMIC_ACQUIRE) - rx_ring_tail);
+}
 
-        /* Appli RSSI offset calibrated for the board */
-        pkt_data[nb_pkt_found].rssic += CONTEXT_RF_CHAIN[pkt_data[nb_pkt_found].rf_chain].rssi_offset;
-        pkt_data[nb_pkt_found].rssis += CONTEXT_RF_CHAIN[pkt_data[nb_pkt_found].rf_chain].rssi_offset;
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-        rssi_temperature_offset = sx1302_rssi_get_temperature_offset(&CONTEXT_RF_CHAIN[pkt_data[nb_pkt_found].rf_chain].rssi_tcomp, current_temperature);
-        pkt_data[nb_pkt_found].rssic += rssi_temperature_offset;
-        pkt_data[nb_pkt_found].rssis += rssi_temperature_offset;
-        DEBUG_PRINTF("INFO: RSSI temperature offset applied: %.3f dB (current temperature %.1f C)\n", rssi_temperature_offset, current_temperature);
-    }
+int lgw_rx_thread_eventfd(void) {
+#ifdef _WIN32
+    return -1;
+#else
+    return (rx_thread_running == true) ? rx_thread_event : -1;
+#endif
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-    DEBUG_PRINTF("INFO: nb pkt found:%u left:%u\n", nb_pkt_found, nb_pkt_left);
+int lgw_rx_thread_get_stats(struct lgw_rx_thread_stats_s * stats) {
+    CHECK_NULL(stats);
 
-    return nb_pkt_found;
+    stats->nb_poll = __atomic_load_n(&rx_thread_stats.nb_poll, __ATOMIC_RELAXED);
+    stats->nb_poll_error = __atomic_load_n(&rx_thread_stats.nb_poll_error, __ATOMIC_RELAXED);
+    stats->nb_pkt_received = __atomic_load_n(&rx_thread_stats.nb_pkt_received, __ATOMIC_RELAXED);
+    stats->nb_pkt_dropped = __atomic_load_n(&rx_thread_stats.nb_pkt_dropped, __ATOMIC_RELAXED);
+    stats->nb_ring_full = __atomic_load_n(&rx_thread_stats.nb_ring_full, __ATOMIC_RELAXED);
+    stats->ring_peak = __atomic_load_n(&rx_thread_stats.ring_peak, __ATOMIC_RELAXED);
+
+    return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -825,7 +2395,9 @@ int lgw_send(struct lgw_pkt_tx_s * pkt_data) {
     }
 
     /* Send the TX request to the concentrator */
+    concentrator_lock();
     err = sx1302_send(CONTEXT_LWAN_PUBLIC, &CONTEXT_FSK, pkt_data);
+    concentrator_unlock();
     if (err != LGW_REG_SUCCESS) {
         printf("ERROR: %s: Failed to send packet\n", __FUNCTION__);
         return LGW_HAL_ERROR;
@@ -850,13 +2422,17 @@ int lgw_status(uint8_t rf_chain, uint8_t select, uint8_t *code) {
         if (CONTEXT_STARTED == false) {
             *code = TX_OFF;
         } else {
+            concentrator_lock();
             *code = sx1302_tx_status(rf_chain);
+            concentrator_unlock();
         }
     } else if (select == RX_STATUS) {
         if (CONTEXT_STARTED == false) {
             *code = RX_OFF;
         } else {
+            concentrator_lock();
             *code = sx1302_rx_status(rf_chain);
+            concentrator_unlock();
         }
     } else {
         DEBUG_MSG("ERROR: SELECTION INVALID, NO STATUS TO RETURN\n");
@@ -876,7 +2452,9 @@ int lgw_abort_tx(uint8_t rf_chain) {
     }
 
     /* Abort current TX */
+    concentrator_lock();
     err = sx1302_tx_abort(rf_chain);
+    concentrator_unlock();
     return err;
 }
 
@@ -885,7 +2463,9 @@ int lgw_abort_tx(uint8_t rf_chain) {
 int lgw_get_trigcnt(uint32_t* trig_cnt_us) {
     CHECK_NULL(trig_cnt_us);
 
+    concentrator_lock();
     *trig_cnt_us = sx1302_timestamp_counter(true);
+    concentrator_unlock();
 
     return LGW_HAL_SUCCESS;
 }
@@ -893,19 +2473,123 @@ int lgw_get_trigcnt(uint32_t* trig_cnt_us) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int lgw_get_instcnt(uint32_t* inst_cnt_us) {
+    int err;
+    uint64_t cnt_us;
+    uint32_t err_us;
+
     CHECK_NULL(inst_cnt_us);
 
-    *inst_cnt_us = sx1302_timestamp_counter(false);
+    concentrator_lock();
+    err = sx1302_timestamp_counter_estimate(LGW_INSTCNT_ERROR_MAX, &cnt_us, &err_us);
+    concentrator_unlock();
+    if (err != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    *inst_cnt_us = (uint32_t)cnt_us;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt64(uint64_t * inst_cnt_us) {
+    int err;
+    uint32_t err_us;
+
+    CHECK_NULL(inst_cnt_us);
+
+    concentrator_lock();
+    err = sx1302_timestamp_counter_estimate(LGW_INSTCNT_ERROR_MAX, inst_cnt_us, &err_us);
+    concentrator_unlock();
+
+    return (err == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_instcnt_estimate(uint32_t max_error_us, uint64_t * inst_cnt_us, uint32_t * error_us) {
+    int err;
+
+    CHECK_NULL(inst_cnt_us);
+    CHECK_NULL(error_us);
+
+    concentrator_lock();
+    err = sx1302_timestamp_counter_estimate(max_error_us, inst_cnt_us, error_us);
+    concentrator_unlock();
+
+    return (err == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_get_trigcnt64(uint64_t * trig_cnt_us) {
+    int err;
+
+    CHECK_NULL(trig_cnt_us);
+
+    concentrator_lock();
+    err = sx1302_timestamp_counter64(true, trig_cnt_us);
+    concentrator_unlock();
+
+    return (err == LGW_REG_SUCCESS) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_time64_to_count_us(uint64_t time_us, uint32_t * count_us) {
+    int err;
+    uint64_t now_us;
+    uint32_t err_us;
+
+    CHECK_NULL(count_us);
+
+    concentrator_lock();
+    err = sx1302_timestamp_counter_estimate(LGW_INSTCNT_ERROR_MAX, &now_us, &err_us);
+    concentrator_unlock();
+    if (err != LGW_REG_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+
+    /* The 32-bits counter used for TX must not be ambiguous */
+    if (time_us < now_us) {
+        printf("ERROR: TX time %" PRIu64 " us is in the past (now %" PRIu64 " us)\n", time_us, now_us);
+        return LGW_HAL_ERROR;
+    }
+    if ((time_us - now_us) >= ((uint64_t)1 << 31)) {
+        printf("ERROR: TX time %" PRIu64 " us is too far ahead (now %" PRIu64 " us)\n", time_us, now_us);
+        return LGW_HAL_ERROR;
+    }
+    *count_us = (uint32_t)time_us;
 
     return LGW_HAL_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_get_xtal_correct(double * xtal_correct, double * sigma_ppm) {
+    int err;
+
+    CHECK_NULL(xtal_correct);
+    CHECK_NULL(sigma_ppm);
+
+    concentrator_lock();
+    err = timestamp_xtal_correct(xtal_correct, sigma_ppm);
+    concentrator_unlock();
+
+    return (err == 0) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_get_eui(uint64_t* eui) {
+    int err;
+
     CHECK_NULL(eui);
 
-    if (sx1302_get_eui(eui) != LGW_REG_SUCCESS) {
+    concentrator_lock();
+    err = sx1302_get_eui(eui);
+    concentrator_unlock();
+    if (err != LGW_REG_SUCCESS) {
         return LGW_HAL_ERROR;
     }
     return LGW_HAL_SUCCESS;
@@ -914,8 +2598,18 @@ int lgw_get_eui(uint64_t* eui) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int lgw_get_temperature(float* temperature) {
+    int err;
+
     CHECK_NULL(temperature);
-    return lgw_com_get_temperature(temperature);
+
+    concentrator_lock();
+    err = lgw_com_get_temperature(temperature);
+    if (err == 0) {
+        rssi_tcomp_set(*temperature); /* free sample for the RSSI compensation */
+    }
+    concentrator_unlock();
+
+    return err;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
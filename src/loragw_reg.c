@@ -22,6 +22,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* bool type */
 #include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memcpy, memset */
 
 #include "loragw_reg.h"
 
@@ -59,6 +60,14 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define SX1302_REG_TIMESTAMP_BASE_ADDR 0x6100
 #define SX1302_REG_OTP_BASE_ADDR 0x6180
 
+/* register image records: [ADDR_MSB ADDR_LSB LEN DATA...] or [ADDR_MSB|RMW ADDR_LSB MASK DATA] */
+#define REG_IMAGE_RMW_FLAG      0x80
+#define REG_IMAGE_HDR_SIZE      3
+#define REG_IMAGE_BURST_MAX     255
+#define REG_IMAGE_SPAN_MAX      1024    /* max address span of a register range */
+#define REG_IMAGE_BULK_REQ_MAX  255     /* max number of requests in a single bulk transfer */
+#define REG_IMAGE_RMW_REQ_MAX   4       /* max number of read-modify-write requests for one byte */
+
 const struct lgw_reg_s loregs[LGW_TOTALREGS+1] = {
     {0,SX1302_REG_COMMON_BASE_ADDR+0,0,0,2,0,1,0}, // COMMON_PAGE_PAGE
     {0,SX1302_REG_COMMON_BASE_ADDR+1,4,0,1,0,1,0}, // COMMON_CTRL0_CLK32_RIF_CTRL
@@ -1160,6 +1169,40 @@ int reg_r(uint8_t spi_mux_target, struct lgw_reg_s r, int32_t *reg_value) {
     return com_stat;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int reg_image_append_burst(uint16_t addr, const uint8_t *data, uint8_t len, uint8_t *image, uint16_t max_size, uint16_t *size) {
+    if ((*size + REG_IMAGE_HDR_SIZE + len) > max_size) {
+        DEBUG_MSG("ERROR: REGISTER IMAGE BUFFER TOO SMALL\n");
+        return LGW_REG_ERROR;
+    }
+
+    image[*size + 0] = (uint8_t)((addr >> 8) & 0x7F);
+    image[*size + 1] = (uint8_t)((addr >> 0) & 0xFF);
+    image[*size + 2] = len;
+    memcpy(&image[*size + REG_IMAGE_HDR_SIZE], data, len);
+    *size += REG_IMAGE_HDR_SIZE + len;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int reg_image_append_rmw(uint16_t addr, uint8_t mask, uint8_t data, uint8_t *image, uint16_t max_size, uint16_t *size) {
+    if ((*size + REG_IMAGE_HDR_SIZE + 1) > max_size) {
+        DEBUG_MSG("ERROR: REGISTER IMAGE BUFFER TOO SMALL\n");
+        return LGW_REG_ERROR;
+    }
+
+    image[*size + 0] = (uint8_t)((addr >> 8) & 0x7F) | REG_IMAGE_RMW_FLAG;
+    image[*size + 1] = (uint8_t)((addr >> 0) & 0xFF);
+    image[*size + 2] = mask;
+    image[*size + 3] = data & mask;
+    *size += REG_IMAGE_HDR_SIZE + 1;
+
+    return LGW_REG_SUCCESS;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -1340,6 +1383,38 @@ int lgw_reg_rb(uint16_t register_id, uint8_t *data, uint16_t size) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int lgw_reg_rb_multi(const uint16_t *register_id, lgw_com_rb_req_t *req, uint8_t nb_req) {
+    int com_stat = LGW_COM_SUCCESS;
+    int i;
+
+    /* check input parameters */
+    CHECK_NULL(register_id);
+    CHECK_NULL(req);
+    for (i = 0; i < nb_req; i++) {
+        if (req[i].size == 0) {
+            DEBUG_MSG("ERROR: BURST OF NULL LENGTH\n");
+            return LGW_REG_ERROR;
+        }
+        if (register_id[i] >= LGW_TOTALREGS) {
+            DEBUG_MSG("ERROR: REGISTER NUMBER OUT OF DEFINED RANGE\n");
+            return LGW_REG_ERROR;
+        }
+        req[i].address = loregs[register_id[i]].addr;
+    }
+
+    /* do all the burst reads */
+    com_stat = lgw_com_rb_multi(LGW_SPI_MUX_TARGET_SX1302, req, nb_req);
+
+    if (com_stat != LGW_COM_SUCCESS) {
+        DEBUG_MSG("ERROR: COM ERROR DURING REGISTER BURST READ\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int lgw_mem_wb(uint16_t mem_addr, const uint8_t *data, uint16_t size) {
     int com_stat = LGW_COM_SUCCESS;
     int chunk_cnt = 0;
@@ -1420,4 +1495,158 @@ int lgw_mem_rb(uint16_t mem_addr, uint8_t *data, uint16_t size, bool fifo_mode)
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_image_read(uint16_t first_id, uint16_t last_id, uint8_t *image, uint16_t max_size, uint16_t *size) {
+    uint8_t span[REG_IMAGE_SPAN_MAX];
+    uint8_t mask[REG_IMAGE_SPAN_MAX];  /* restorable bits of each byte */
+    bool used[REG_IMAGE_SPAN_MAX];     /* byte holds at least one field of the range */
+    uint16_t addr_min = 0x7FFF, addr_max = 0;
+    uint16_t i, run_start = 0;
+    uint8_t run_len = 0;
+    struct lgw_reg_s r;
+
+    /* check input parameters */
+    CHECK_NULL(image);
+    CHECK_NULL(size);
+    if ((first_id > last_id) || (last_id >= LGW_TOTALREGS)) {
+        DEBUG_MSG("ERROR: REGISTER NUMBER OUT OF DEFINED RANGE\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* get the address span of the range */
+    for (i = first_id; i <= last_id; i++) {
+        addr_min = (loregs[i].addr < addr_min) ? loregs[i].addr : addr_min;
+        addr_max = (loregs[i].addr > addr_max) ? loregs[i].addr : addr_max;
+    }
+    if ((addr_max - addr_min + 1) > REG_IMAGE_SPAN_MAX) {
+        DEBUG_MSG("ERROR: REGISTER RANGE SPAN IS TOO LARGE\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* build the mask of bits which can be written back */
+    memset(mask, 0, sizeof mask);
+    memset(used, 0, sizeof used);
+    for (i = first_id; i <= last_id; i++) {
+        r = loregs[i];
+        used[r.addr - addr_min] = true;
+        if ((r.rdon == 0) && (r.chck == 1)) {
+            mask[r.addr - addr_min] |= (uint8_t)(((1 << r.leng) - 1) << r.offs);
+        }
+    }
+
+    /* read the whole span at once */
+    if (lgw_com_rb(LGW_SPI_MUX_TARGET_SX1302, addr_min, span, addr_max - addr_min + 1) != LGW_COM_SUCCESS) {
+        DEBUG_MSG("ERROR: COM ERROR DURING REGISTER IMAGE READ\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* full bytes are grouped in bursts, partial bytes are read-modify-write */
+    for (i = 0; i <= (addr_max - addr_min); i++) {
+        if ((used[i] == true) && (mask[i] == 0xFF)) {
+            if (run_len == 0) {
+                run_start = i;
+            }
+            run_len += 1;
+            if (run_len < REG_IMAGE_BURST_MAX) {
+                continue;
+            }
+        }
+        if (run_len > 0) {
+            if (reg_image_append_burst(addr_min + run_start, &span[run_start], run_len, image, max_size, size) != LGW_REG_SUCCESS) {
+                return LGW_REG_ERROR;
+            }
+            run_len = 0;
+        }
+        if ((used[i] == true) && (mask[i] != 0x00) && (mask[i] != 0xFF)) {
+            if (reg_image_append_rmw(addr_min + i, mask[i], span[i], image, max_size, size) != LGW_REG_SUCCESS) {
+                return LGW_REG_ERROR;
+            }
+        }
+    }
+    if (run_len > 0) {
+        if (reg_image_append_burst(addr_min + run_start, &span[run_start], run_len, image, max_size, size) != LGW_REG_SUCCESS) {
+            return LGW_REG_ERROR;
+        }
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_reg_image_write(const uint8_t *image, uint16_t size) {
+    int com_stat = LGW_COM_SUCCESS;
+    uint16_t idx = 0;
+    uint16_t addr;
+    uint16_t bulk_size = 0;
+    uint16_t req_size;
+    int bulk_req_nb = 0;
+    uint8_t mask, offs, leng;
+    const uint16_t CHUNK_SIZE_MAX = lgw_com_chunk_size();
+
+    /* check input parameters */
+    CHECK_NULL(image);
+
+    com_stat |= lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+    while ((idx < size) && (com_stat == LGW_COM_SUCCESS)) {
+        if ((idx + REG_IMAGE_HDR_SIZE) > size) {
+            DEBUG_MSG("ERROR: TRUNCATED REGISTER IMAGE\n");
+            com_stat = LGW_COM_ERROR;
+            break;
+        }
+        addr = (uint16_t)((image[idx] & 0x7F) << 8) | image[idx + 1];
+
+        /* flush pending requests if this one would not fit in the bulk buffer */
+        req_size = (image[idx] & REG_IMAGE_RMW_FLAG) ? (6 * REG_IMAGE_RMW_REQ_MAX) : (image[idx + 2] + 8);
+        if (((bulk_size + req_size) > CHUNK_SIZE_MAX) || ((bulk_req_nb + REG_IMAGE_RMW_REQ_MAX) > REG_IMAGE_BULK_REQ_MAX)) {
+            com_stat |= lgw_com_flush();
+            com_stat |= lgw_com_set_write_mode(LGW_COM_WRITE_MODE_BULK);
+            bulk_size = 0;
+            bulk_req_nb = 0;
+        }
+
+        if (image[idx] & REG_IMAGE_RMW_FLAG) {
+            if ((idx + REG_IMAGE_HDR_SIZE + 1) > size) {
+                DEBUG_MSG("ERROR: TRUNCATED REGISTER IMAGE\n");
+                com_stat = LGW_COM_ERROR;
+                break;
+            }
+            /* one read-modify-write per contiguous group of bits in the mask */
+            mask = image[idx + 2];
+            offs = 0;
+            while (offs < 8) {
+                if ((mask & (1 << offs)) == 0) {
+                    offs += 1;
+                    continue;
+                }
+                for (leng = 0; ((offs + leng) < 8) && (mask & (1 << (offs + leng))); leng++);
+                com_stat |= lgw_com_rmw(LGW_SPI_MUX_TARGET_SX1302, addr, offs, leng, (image[idx + 3] >> offs) & ((1 << leng) - 1));
+                bulk_size += 6;
+                bulk_req_nb += 1;
+                offs += leng;
+            }
+            idx += REG_IMAGE_HDR_SIZE + 1;
+        } else {
+            if ((idx + REG_IMAGE_HDR_SIZE + image[idx + 2]) > size) {
+                DEBUG_MSG("ERROR: TRUNCATED REGISTER IMAGE\n");
+                com_stat = LGW_COM_ERROR;
+                break;
+            }
+            com_stat |= lgw_com_wb(LGW_SPI_MUX_TARGET_SX1302, addr, &image[idx + REG_IMAGE_HDR_SIZE], image[idx + 2]);
+            bulk_size += req_size;
+            bulk_req_nb += 1;
+            idx += REG_IMAGE_HDR_SIZE + image[idx + 2];
+        }
+    }
+    com_stat |= lgw_com_flush();
+
+    if (com_stat != LGW_COM_SUCCESS) {
+        DEBUG_MSG("ERROR: COM ERROR DURING REGISTER IMAGE WRITE\n");
+        return LGW_REG_ERROR;
+    } else {
+        return LGW_REG_SUCCESS;
+    }
+}
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -44,6 +44,20 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
+/* Image calibration bands: frequency range (exclusive) and CALIBRATE_IMAGE arguments */
+static const struct {
+    uint32_t freq_min;
+    uint32_t freq_max;
+    uint8_t cal_freq1;
+    uint8_t cal_freq2;
+} image_cal_bands[] = {
+    { 430000000, 440000000, 0x6B, 0x6F },
+    { 470000000, 510000000, 0x75, 0x81 },
+    { 779000000, 787000000, 0xC1, 0xC5 },
+    { 863000000, 870000000, 0xD7, 0xDB },
+    { 902000000, 928000000, 0xE1, 0xE9 }
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -89,33 +103,36 @@ int sx1250_reg_r(sx1250_op_code_t op_code, uint8_t *data, uint16_t size, uint8_t
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1250_calibrate_band(uint32_t freq_hz) {
+    int i;
+
+    for (i = 0; i < (int)ARRAY_SIZE(image_cal_bands); i++) {
+        if ((freq_hz > image_cal_bands[i].freq_min) && (freq_hz < image_cal_bands[i].freq_max)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1250_calibrate(uint8_t rf_chain, uint32_t freq_hz) {
     int err = LGW_REG_SUCCESS;
     uint8_t buff[16];
+    int band;
 
     buff[0] = 0x00;
     err |= sx1250_reg_r(GET_STATUS, buff, 1, rf_chain);
 
     /* Run calibration */
-    if ((freq_hz > 430E6) && (freq_hz < 440E6)) {
-        buff[0] = 0x6B;
-        buff[1] = 0x6F;
-    } else if ((freq_hz > 470E6) && (freq_hz < 510E6)) {
-        buff[0] = 0x75;
-        buff[1] = 0x81;
-    } else if ((freq_hz > 779E6) && (freq_hz < 787E6)) {
-        buff[0] = 0xC1;
-        buff[1] = 0xC5;
-    } else if ((freq_hz > 863E6) && (freq_hz < 870E6)) {
-        buff[0] = 0xD7;
-        buff[1] = 0xDB;
-    } else if ((freq_hz > 902E6) && (freq_hz < 928E6)) {
-        buff[0] = 0xE1;
-        buff[1] = 0xE9;
-    } else {
+    band = sx1250_calibrate_band(freq_hz);
+    if (band < 0) {
         printf("ERROR: failed to calibrate sx1250 radio, frequency range not supported (%u)\n", freq_hz);
         return LGW_REG_ERROR;
     }
+    buff[0] = image_cal_bands[band].cal_freq1;
+    buff[1] = image_cal_bands[band].cal_freq2;
     err |= sx1250_reg_w(CALIBRATE_IMAGE, buff, 2, rf_chain);
 
     /* Wait for calibration to complete */
@@ -135,6 +152,26 @@ int sx1250_calibrate(uint8_t rf_chain, uint32_t freq_hz) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1250_get_device_errors(uint8_t rf_chain, uint16_t * dev_errors) {
+    int err;
+    uint8_t buff[3];
+
+    CHECK_NULL(dev_errors);
+
+    buff[0] = 0x00;
+    buff[1] = 0x00;
+    buff[2] = 0x00;
+    err = sx1250_reg_r(GET_DEVICE_ERRORS, buff, 3, rf_chain);
+    if (err != LGW_REG_SUCCESS) {
+        return LGW_REG_ERROR;
+    }
+    *dev_errors = ((uint16_t)buff[1] << 8) | buff[2];
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1250_setup(uint8_t rf_chain, uint32_t freq_hz, bool single_input_mode) {
     int32_t freq_reg;
     uint8_t buff[16];
@@ -258,4 +295,53 @@ int sx1250_setup(uint8_t rf_chain, uint32_t freq_hz, bool single_input_mode) {
     return LGW_REG_SUCCESS;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1250_set_rx_freq(uint8_t rf_chain, uint32_t freq_hz, bool calibrate) {
+    int32_t freq_reg;
+    uint8_t buff[16];
+    int err = LGW_REG_SUCCESS;
+
+    /* Leave Rx: frequency and image calibration can only be changed from Standby */
+    buff[0] = (uint8_t)STDBY_XOSC;
+    err |= sx1250_reg_w(SET_STANDBY, buff, 1, rf_chain);
+
+    buff[0] = 0x00;
+    err |= sx1250_reg_r(GET_STATUS, buff, 1, rf_chain);
+    if ((uint8_t)(TAKE_N_BITS_FROM(buff[0], 4, 3)) != 0x03) {
+        printf("ERROR: Failed to set SX1250_%u in STANDBY_XOSC mode\n", rf_chain);
+        return LGW_REG_ERROR;
+    }
+
+    if (calibrate == true) {
+        err |= sx1250_calibrate(rf_chain, freq_hz);
+    }
+
+    /* Set frequency */
+    freq_reg = SX1250_FREQ_TO_REG(freq_hz);
+    buff[0] = (uint8_t)(freq_reg >> 24);
+    buff[1] = (uint8_t)(freq_reg >> 16);
+    buff[2] = (uint8_t)(freq_reg >> 8);
+    buff[3] = (uint8_t)(freq_reg >> 0);
+    err |= sx1250_reg_w(SET_RF_FREQUENCY, buff, 4, rf_chain);
+
+    /* Back to Rx continuous, as left by sx1250_setup() */
+    buff[0] = 0xFF;
+    buff[1] = 0xFF;
+    buff[2] = 0xFF;
+    err |= sx1250_reg_w(SET_RX, buff, 3, rf_chain);
+
+    buff[0] = 0x05;
+    buff[1] = 0x87;
+    buff[2] = 0x0B;
+    err |= sx1250_reg_w(WRITE_REGISTER, buff, 3, rf_chain); /* FPGA_MODE_RX */
+
+    if (err != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to set SX1250_%u Rx frequency to %u Hz\n", rf_chain, freq_hz);
+        return LGW_REG_ERROR;
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -299,6 +299,24 @@ int sx1261_calibrate(uint32_t freq_hz) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1261_get_device_errors(uint16_t * dev_errors) {
+    int err;
+    uint8_t buff[3];
+
+    CHECK_NULL(dev_errors);
+
+    buff[0] = 0x00;
+    buff[1] = 0x00;
+    buff[2] = 0x00;
+    err = sx1261_reg_r(SX1261_GET_DEVICE_ERRORS, buff, 3);
+    CHECK_ERR(err);
+    *dev_errors = ((uint16_t)buff[1] << 8) | buff[2];
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1261_setup(void) {
     int err;
     uint8_t buff[32];
@@ -30,6 +30,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "loragw_sx1302_timestamp.h"
 #include "loragw_sx1302_rx.h"
 #include "loragw_sx1250.h"
+#include "loragw_cal.h"
 #include "loragw_agc_params.h"
 
 /* -------------------------------------------------------------------------- */
@@ -67,6 +68,9 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define ARB_MEM_ADDR            0x2000
 
 #define MCU_FW_SIZE             8192 /* size of the firmware IN BYTES (= twice the number of 14b words) */
+#define MCU_FW_CHECK_BLOCK_NB   8    /* number of blocks read back to verify a firmware image */
+#define MCU_FW_CHECK_BLOCK_SIZE 64   /* size of each block read back IN BYTES */
+#define MCU_FW_BOOT_TIMEOUT_MS  10   /* time given to an already loaded firmware to publish its version */
 
 #define FW_VERSION_CAL          1 /* Expected version of calibration firmware */
 
@@ -75,6 +79,11 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define RSSI_FSK_POLY_2         0.007129
 #define RSSI_FSK_POLY_3         -0.000026
 
+#define RX_FIFO_FILL_HIGH       (RX_BUFFER_SIZE / 2) /* above this, the SX1302 RX buffer is read again right away */
+#define RX_FIFO_FILL_FULL       (RX_BUFFER_SIZE - 23) /* no room left for a packet, even without payload */
+#define RX_FIFO_POLL_GAP_S      134 /* 27-bit counter wrap period: packets waiting longer cannot be timestamped */
+#define RX_FIFO_TS_BACKWARD_US  16000000 /* packets are not supposed to be timestamped that long before the previous one */
+
 #define FREQ_OFFSET_LSB_125KHZ  0.11920929f     /* 125000 * 32 / 2^6 / 2^19 */
 #define FREQ_OFFSET_LSB_250KHZ  0.238418579f    /* 250000 * 32 / 2^6 / 2^19 */
 #define FREQ_OFFSET_LSB_500KHZ  0.476837158f    /* 500000 * 32 / 2^6 / 2^19 */
@@ -113,15 +122,66 @@ const uint8_t ifmod_config[LGW_IF_CHAIN_NB] = LGW_IFMODEM_CONFIG;
 #define GPIO_CFG_MBIST                  0x0A
 #define GPIO_CFG_OTP                    0x0B
 
+/* Register ranges written by the configuration steps of lgw_start(), captured in a configuration snapshot */
+static const uint16_t config_reg_ranges[][2] = {
+    { SX1302_REG_AGC_MCU_LUT_TABLE_A_PA_LUT, SX1302_REG_AGC_MCU_LUT_TABLE_B_LNA_LUT },
+    { SX1302_REG_GPIO_GPIO_DIR_H_DIRECTION, SX1302_REG_GPIO_GPIO_DIR_L_DIRECTION },
+    { SX1302_REG_GPIO_GPIO_SEL_0_SELECTION, SX1302_REG_GPIO_GPIO_SEL_8_11_GPIO_8_SEL },
+    { SX1302_REG_RX_TOP_FREQ_0_MSB_IF_FREQ_0, SX1302_REG_RX_TOP_DUMMY3_DUMMY3 },
+    { SX1302_REG_ARB_MCU_CHANNEL_SYNC_OFFSET_01_CHANNEL_1_OFFSET, SX1302_REG_ARB_MCU_CHANNEL_SYNC_OFFSET_67_CHANNEL_6_OFFSET },
+    { SX1302_REG_RADIO_FE_GLBL_CTRL_DECIM_B_CLR, SX1302_REG_RADIO_FE_DUMMY_DUMMY },
+    { SX1302_REG_OTP_MODEM_EN_0_MODEM_EN, SX1302_REG_OTP_MODEM_EN_1_MODEM_EN },
+    { SX1302_REG_RX_TOP_LORA_SERVICE_FSK_LORA_SERVICE_FREQ_MSB_IF_FREQ_0, SX1302_REG_RX_TOP_LORA_SERVICE_FSK_DUMMY1_DUMMY1 },
+    { SX1302_REG_COMMON_GEN_GLOBAL_EN, SX1302_REG_COMMON_GEN_MBWSSF_MODEM_ENABLE } /* last: modems enabled once configured */
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
-/* Buffer to hold RX data */
-rx_buffer_t rx_buffer;
+/* Buffers to hold RX data: rx_buffer[rx_buffer_cur] is being parsed while the other one gets the next fetch */
+static rx_buffer_t rx_buffer[2];
+static uint8_t rx_buffer_cur = 0;
+
+/* SX1302 RX buffer fill level and packet loss indicators, see sx1302_rx_buffer_stats() */
+static struct {
+    uint32_t nb_poll;
+    uint16_t fill_last;
+    uint16_t fill_peak;
+    uint32_t fill_rate;         /* bytes/s, averaged over the last polls */
+    uint32_t nb_fifo_full;
+    uint32_t nb_poll_gap;
+    uint32_t nb_ts_discontinuity;
+    uint32_t last_inst;         /* instantaneous counter at the previous poll, in us */
+    uint64_t last_poll_us;      /* host monotonic time of the previous poll */
+    bool last_count_valid;
+    uint32_t last_count_us;     /* timestamp of the previous packet parsed */
+} rx_fifo;
 
 /* Internal timestamp counter */
 timestamp_counter_t counter_us;
 
+/* Payload CRC tables for slicing-by-8: crc_table[k][b] = b * x^(8*(k+2)) mod the CRC polynomial */
+static uint16_t crc_table[8][256];
+static bool crc_table_ready = false;
+
+/* Packets dropped by the RX filter */
+static struct lgw_rx_filter_stats_s rx_filter_stats;
+
+/* Linearized FSK RSSI for each raw channel RSSI value, see RSSI_FSK_POLY_x */
+static float rssi_fsk_lut[256];
+
+/* Values used by sx1302_parse() which only depend on the IF chain configuration */
+static struct {
+    uint8_t ifmod;              /* type of if_chain/modem */
+    uint8_t rf_chain;
+    uint32_t freq_hz;           /* channel center frequency */
+    int32_t if_freq_error;      /* IF frequency lost to the register resolution */
+    uint8_t bandwidth;          /* LoRa: 125KHz for multi-SF, service bandwidth otherwise; FSK: configured one */
+    float freq_offset_lsb;      /* LoRa frequency offset resolution, 0 if bandwidth is invalid */
+    double dc_notch_delay;      /* LoRa fine timestamp DC notch delay */
+    int32_t fsk_timestamp_correction;
+} parse_chain[LGW_IF_CHAIN_NB];
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
@@ -146,6 +206,47 @@ extern int32_t lgw_bw_getval(int x);
 */
 void lora_crc16(const char data, int *crc);
 
+/**
+@brief Build the payload CRC tables from the bitwise CRC
+*/
+static void lora_crc16_table_init(void);
+
+/**
+@brief Compare a few blocks spread over an MCU memory with the given firmware image
+@param mem_addr     Start address of the MCU memory (AGC_MEM_ADDR or ARB_MEM_ADDR)
+@param firmware     A pointer to the expected fw binary
+@param match        A pointer to store the comparison result
+@return LGW_REG_SUCCESS if success, LGW_REG_ERROR otherwise
+*/
+static int mcu_fw_check_blocks(uint16_t mem_addr, const uint8_t *firmware, bool *match);
+
+/**
+@brief Get the rx_buffer to be parsed, moving to the other one when the current one has been parsed
+@return A pointer to the rx_buffer holding the next packet to be parsed
+*/
+static rx_buffer_t * rx_buffer_parsed(void);
+
+/**
+@brief Get the number of packets left to be parsed in both rx_buffers
+@return The number of packets, saturated to 255
+*/
+static uint8_t rx_buffer_pkt_nb(void);
+
+/**
+@brief Update the SX1302 RX buffer fill level indicators, each time its byte count is read
+@param nb_bytes     The number of bytes in the SX1302 RX buffer
+@param inst         The instantaneous counter read along with the byte count, in us
+*/
+static void rx_fifo_update(uint16_t nb_bytes, uint32_t inst);
+
+/**
+@brief Check a packet against the RX filter, on the fields available before parsing it
+@param context      Gateway configuration context
+@param pkt          The packet as read from the rx_buffer
+@return true if the packet is accepted, false if it has to be dropped
+*/
+static bool rx_filter_accept(const lgw_context_t * context, const rx_packet_t * pkt);
+
 /* -------------------------------------------------------------------------- */
 /* --- INTERNAL SHARED VARIABLES -------------------------------------------- */
 
@@ -204,6 +305,52 @@ void lora_crc16(const char data, int *crc) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+static void lora_crc16_table_init(void) {
+    int k, b, crc;
+
+    /* Shifting a zero byte in multiplies the CRC state by x^8 */
+    for (b = 0; b < 256; b++) {
+        crc = b << 8;
+        lora_crc16(0, &crc);
+        crc_table[0][b] = (uint16_t)crc;
+        for (k = 1; k < 8; k++) {
+            lora_crc16(0, &crc);
+            crc_table[k][b] = (uint16_t)crc;
+        }
+    }
+    crc_table_ready = true;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int mcu_fw_check_blocks(uint16_t mem_addr, const uint8_t *firmware, bool *match) {
+    uint8_t fw_check[MCU_FW_CHECK_BLOCK_SIZE];
+    uint16_t offset;
+    int i;
+
+    CHECK_NULL(firmware);
+    CHECK_NULL(match);
+
+    /* Blocks are evenly spread, the last one ending at the end of the image */
+    *match = true;
+    for (i = 0; i < MCU_FW_CHECK_BLOCK_NB; i++) {
+        offset = (uint16_t)(i * ((MCU_FW_SIZE - MCU_FW_CHECK_BLOCK_SIZE) / (MCU_FW_CHECK_BLOCK_NB - 1)));
+        if (lgw_mem_rb(mem_addr + offset, fw_check, MCU_FW_CHECK_BLOCK_SIZE, false) != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to read back MCU memory at 0x%04X\n", mem_addr + offset);
+            return LGW_REG_ERROR;
+        }
+        if (memcmp(&firmware[offset], fw_check, MCU_FW_CHECK_BLOCK_SIZE) != 0) {
+            DEBUG_PRINTF("MCU memory mismatch in block at 0x%04X\n", mem_addr + offset);
+            *match = false;
+            break;
+        }
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_config_gpio(void) {
     int err;
 
@@ -229,6 +376,135 @@ int sx1302_config_gpio(void) {
     return LGW_REG_SUCCESS;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static rx_buffer_t * rx_buffer_parsed(void) {
+    if ((rx_buffer[rx_buffer_cur].buffer_pkt_nb == 0) && (rx_buffer[rx_buffer_cur ^ 1].buffer_pkt_nb > 0)) {
+        rx_buffer_cur ^= 1;
+    }
+
+    return &rx_buffer[rx_buffer_cur];
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static uint8_t rx_buffer_pkt_nb(void) {
+    int nb_pkt;
+
+    nb_pkt = rx_buffer[0].buffer_pkt_nb + rx_buffer[1].buffer_pkt_nb;
+
+    return (nb_pkt > UINT8_MAX) ? UINT8_MAX : (uint8_t)nb_pkt;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void rx_fifo_update(uint16_t nb_bytes, uint32_t inst) {
+    uint64_t now_us, gap_s;
+    uint32_t delta_us;
+    uint64_t rate;
+
+    now_us = timestamp_host_us();
+    if (rx_fifo.nb_poll > 0) {
+        /* The RX buffer was emptied at the previous poll: what is in it now came since */
+        delta_us = inst - rx_fifo.last_inst;
+        if (delta_us > 0) {
+            rate = (uint64_t)nb_bytes * 1000000 / delta_us;
+            rx_fifo.fill_rate = (uint32_t)((int64_t)rx_fifo.fill_rate + ((int64_t)rate - (int64_t)rx_fifo.fill_rate) / 8);
+        }
+
+        gap_s = (now_us - rx_fifo.last_poll_us) / 1000000;
+        if (gap_s >= RX_FIFO_POLL_GAP_S) {
+            rx_fifo.nb_poll_gap += 1;
+            printf("WARNING: %lu seconds since last RX buffer poll, timestamps of old packets may be wrong\n", (unsigned long)gap_s);
+        }
+    }
+    rx_fifo.last_inst = inst;
+    rx_fifo.last_poll_us = now_us;
+
+    rx_fifo.nb_poll += 1;
+    rx_fifo.fill_last = nb_bytes;
+    if (nb_bytes > rx_fifo.fill_peak) {
+        rx_fifo.fill_peak = nb_bytes;
+    }
+    if (nb_bytes >= RX_FIFO_FILL_FULL) {
+        rx_fifo.nb_fifo_full += 1;
+        printf("WARNING: SX1302 RX buffer full (%u bytes), packets may have been lost\n", nb_bytes);
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static bool rx_filter_accept(const lgw_context_t * context, const rx_packet_t * pkt) {
+    const struct lgw_conf_rx_filter_s * f = &context->rx_filter_cfg;
+    const uint8_t * mac = pkt->payload;
+    uint8_t ifmod, mtype;
+    uint32_t devaddr;
+    int i;
+
+    if (f->enable == false) {
+        return true;
+    }
+
+    /* Cheapest checks first */
+    if ((f->if_chain_mask != 0) && (pkt->rx_channel_in < LGW_IF_CHAIN_NB) && !(f->if_chain_mask & (1 << pkt->rx_channel_in))) {
+        rx_filter_stats.nb_drop_if_chain += 1;
+        return false;
+    }
+    ifmod = (pkt->rx_channel_in < LGW_IF_CHAIN_NB) ? parse_chain[pkt->rx_channel_in].ifmod : IF_UNDEFINED;
+    if (pkt->crc_en || ((ifmod == IF_LORA_STD) && (context->lora_service_cfg.implicit_crc_en == true))) {
+        if ((f->drop_crc_bad == true) && pkt->payload_crc_error) {
+            rx_filter_stats.nb_drop_crc_bad += 1;
+            return false;
+        }
+    } else if (f->drop_no_crc == true) {
+        rx_filter_stats.nb_drop_no_crc += 1;
+        return false;
+    }
+    if ((f->sf_mask != 0) && ((ifmod == IF_LORA_MULTI) || (ifmod == IF_LORA_STD))) {
+        if ((pkt->rx_rate_sf < 5) || (pkt->rx_rate_sf > 12) || !(f->sf_mask & (1 << (pkt->rx_rate_sf - 5)))) {
+            rx_filter_stats.nb_drop_datarate += 1;
+            return false;
+        }
+    }
+    if ((pkt->rxbytenb_modem < f->size_min) || ((f->size_max != 0) && (pkt->rxbytenb_modem > f->size_max))) {
+        rx_filter_stats.nb_drop_size += 1;
+        return false;
+    }
+
+    /* LoRaWAN MAC header, then DevAddr of data frames (MType 2 to 5) */
+    if ((f->mtype_mask != 0) || (f->devaddr_nb > 0)) {
+        if (pkt->rxbytenb_modem < 1) {
+            rx_filter_stats.nb_drop_size += 1;
+            return false;
+        }
+        mtype = mac[0] >> 5;
+        if ((f->mtype_mask != 0) && !(f->mtype_mask & (1 << mtype))) {
+            rx_filter_stats.nb_drop_mtype += 1;
+            return false;
+        }
+        if ((f->devaddr_nb > 0) && (mtype >= 2) && (mtype <= 5)) {
+            if (pkt->rxbytenb_modem < 5) {
+                rx_filter_stats.nb_drop_size += 1;
+                return false;
+            }
+            devaddr = (uint32_t)mac[1] | ((uint32_t)mac[2] << 8) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 24);
+            for (i = 0; (i < f->devaddr_nb) && (i < LGW_RX_FILTER_DEVADDR_NB); i++) {
+                if ((devaddr & f->devaddr_mask[i]) == f->devaddr_value[i]) {
+                    break;
+                }
+            }
+            if ((i == f->devaddr_nb) || (i == LGW_RX_FILTER_DEVADDR_NB)) {
+                rx_filter_stats.nb_drop_devaddr += 1;
+                return false;
+            }
+        }
+    }
+
+    rx_filter_stats.nb_pkt_accepted += 1;
+
+    return true;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -238,8 +514,17 @@ int sx1302_init(void) {
     /* Initialize internal counter */
     timestamp_counter_new(&counter_us);
 
-    /* Initialize RX buffer */
-    rx_buffer_new(&rx_buffer);
+    /* Initialize RX buffers */
+    rx_buffer_new(&rx_buffer[0]);
+    rx_buffer_new(&rx_buffer[1]);
+    rx_buffer_cur = 0;
+    memset(&rx_fifo, 0, sizeof rx_fifo);
+    memset(&rx_filter_stats, 0, sizeof rx_filter_stats);
+
+    /* Initialize payload CRC tables */
+    if (crc_table_ready == false) {
+        lora_crc16_table_init();
+    }
 
     x = timestamp_counter_mode();
     if (x != LGW_REG_SUCCESS) {
@@ -258,6 +543,47 @@ int sx1302_init(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_config_snapshot(uint8_t * image, uint16_t max_size, uint16_t * size) {
+    unsigned int i;
+
+    CHECK_NULL(image);
+    CHECK_NULL(size);
+
+    *size = 0;
+    for (i = 0; i < ARRAY_SIZE(config_reg_ranges); i++) {
+        if (lgw_reg_image_read(config_reg_ranges[i][0], config_reg_ranges[i][1], image, max_size, size) != LGW_REG_SUCCESS) {
+            printf("ERROR: failed to read configuration registers (range %u)\n", i);
+            return LGW_REG_ERROR;
+        }
+    }
+    DEBUG_PRINTF("SX1302 configuration snapshot: %u bytes\n", *size);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_config_restore(const uint8_t * image, uint16_t size) {
+    CHECK_NULL(image);
+
+    /* Same host side initialization as sx1302_init() */
+    timestamp_counter_new(&counter_us);
+    rx_buffer_new(&rx_buffer[0]);
+    rx_buffer_new(&rx_buffer[1]);
+    rx_buffer_cur = 0;
+    memset(&rx_fifo, 0, sizeof rx_fifo);
+    memset(&rx_filter_stats, 0, sizeof rx_filter_stats);
+
+    if (lgw_reg_image_write(image, size) != LGW_REG_SUCCESS) {
+        printf("ERROR: failed to restore configuration registers\n");
+        return LGW_REG_ERROR;
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_get_eui(uint64_t * eui) {
     int i, err;
     int32_t val;
@@ -305,9 +631,13 @@ int sx1302_get_model_id(sx1302_model_id_t * model_id) {
 
 int sx1302_update(void) {
     uint32_t inst, pps;
+    uint64_t cnt_us;
+    uint32_t err_us;
 
-    /* Update internal timestamp counter wrapping status */
-    timestamp_counter_get(&counter_us, &inst, &pps);
+    /* Update internal timestamp counter wrapping status, only when the last read is too old to extrapolate it */
+    if (timestamp_counter_estimate(&counter_us, timestamp_host_us(), &cnt_us, &err_us) != 0) {
+        timestamp_counter_get(&counter_us, &inst, &pps);
+    }
 
     return LGW_REG_SUCCESS;
 }
@@ -432,9 +762,10 @@ int sx1302_radio_host_ctrl(bool host_ctrl) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc) {
+int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t clksrc, float temperature) {
     int i;
     int err = LGW_REG_SUCCESS;
+    uint16_t dev_errors;
 
     /* -- Reset radios */
     for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
@@ -467,11 +798,22 @@ int sx1302_radio_calibrate(struct lgw_conf_rxrf_s * context_rf_chain, uint8_t cl
     DEBUG_MSG("Calibrating sx1250 radios\n");
     for (i = 0; i < LGW_RF_CHAIN_NB; i++) {
         if (context_rf_chain[i].enable == true) {
+            /* Radios are reset again before setup, a cached result for this band and temperature is enough */
+            if (cal_cache_match(i, context_rf_chain[i].freq_hz, temperature, false) == true) {
+                DEBUG_PRINTF("INFO: skipping sx1250_%d image calibration, cached result still valid\n", i);
+                continue;
+            }
             err = sx1250_calibrate(i, context_rf_chain[i].freq_hz);
             if (err != LGW_REG_SUCCESS) {
                 printf("ERROR: radio calibration failed\n");
                 return LGW_REG_ERROR;
             }
+            err = sx1250_get_device_errors(i, &dev_errors);
+            if (err != LGW_REG_SUCCESS) {
+                printf("ERROR: failed to get radio %d device errors\n", i);
+                return LGW_REG_ERROR;
+            }
+            cal_cache_store(i, context_rf_chain[i].freq_hz, dev_errors, temperature);
         }
     }
     
@@ -996,6 +1338,34 @@ int sx1302_lora_service_modem_configure(struct lgw_conf_rxif_s * cfg, uint32_t r
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_lora_freq_to_time_configure(uint32_t radio_freq_hz, uint8_t service_bw) {
+    uint16_t mantissa = 0;
+    uint8_t exponent = 0;
+    int err = LGW_REG_SUCCESS;
+
+    /* LoRa multi-SF modems */
+    if (calculate_freq_to_time_drift(radio_freq_hz, BW_125KHZ, &mantissa, &exponent) != 0) {
+        printf("ERROR: failed to calculate frequency to time drift for LoRa modem\n");
+        return LGW_REG_ERROR;
+    }
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_FREQ_TO_TIME0_FREQ_TO_TIME_DRIFT_MANT, (mantissa >> 8) & 0x00FF);
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_FREQ_TO_TIME1_FREQ_TO_TIME_DRIFT_MANT, (mantissa) & 0x00FF);
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_FREQ_TO_TIME2_FREQ_TO_TIME_DRIFT_EXP, exponent);
+
+    /* LoRa service modem */
+    if (calculate_freq_to_time_drift(radio_freq_hz, service_bw, &mantissa, &exponent) != 0) {
+        printf("ERROR: failed to calculate frequency to time drift for LoRa service modem\n");
+        return LGW_REG_ERROR;
+    }
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_LORA_SERVICE_FSK_FREQ_TO_TIME0_FREQ_TO_TIME_DRIFT_MANT, (mantissa >> 8) & 0x00FF);
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_LORA_SERVICE_FSK_FREQ_TO_TIME1_FREQ_TO_TIME_DRIFT_MANT, (mantissa) & 0x00FF);
+    err |= lgw_reg_w(SX1302_REG_RX_TOP_LORA_SERVICE_FSK_FREQ_TO_TIME2_FREQ_TO_TIME_DRIFT_EXP, exponent);
+
+    return err;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_modem_enable(void) {
     int err = LGW_REG_SUCCESS;
 
@@ -1016,6 +1386,12 @@ int sx1302_modem_enable(void) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_rx_enable(bool enable) {
+    return lgw_reg_w(SX1302_REG_COMMON_GEN_GLOBAL_EN, (enable == true) ? 0x01 : 0x00);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_lora_syncword(bool public, uint8_t lora_service_sf) {
     int err = LGW_REG_SUCCESS;
 
@@ -1059,6 +1435,46 @@ uint32_t sx1302_timestamp_counter(bool pps) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_timestamp_counter64(bool pps, uint64_t * cnt_us) {
+    uint32_t inst_cnt, pps_cnt;
+
+    CHECK_NULL(cnt_us);
+
+    if (timestamp_counter_get(&counter_us, &inst_cnt, &pps_cnt) != 0) {
+        return LGW_REG_ERROR;
+    }
+    *cnt_us = counter_us.inst_us_64bits;
+    if (pps == true) {
+        *cnt_us = timestamp_counter_expand64(&counter_us, pps_cnt & 0x07FFFFFF);
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_timestamp_counter_estimate(uint32_t max_err_us, uint64_t * cnt_us, uint32_t * err_us) {
+    uint32_t inst_cnt, pps_cnt;
+
+    CHECK_NULL(cnt_us);
+    CHECK_NULL(err_us);
+
+    if ((timestamp_counter_estimate(&counter_us, timestamp_host_us(), cnt_us, err_us) == 0) && (*err_us <= max_err_us)) {
+        return LGW_REG_SUCCESS;
+    }
+
+    /* Model is stale: read the counter, which refreshes it */
+    if (timestamp_counter_get(&counter_us, &inst_cnt, &pps_cnt) != 0) {
+        return LGW_REG_ERROR;
+    }
+    *cnt_us = counter_us.inst_us_64bits;
+    *err_us = counter_us.host_ref_jitter_us;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_gps_enable(bool enable) {
     int err = LGW_REG_SUCCESS;
 
@@ -1076,7 +1492,7 @@ int sx1302_gps_enable(bool enable) {
 
 int sx1302_agc_load_firmware(const uint8_t *firmware) {
     int32_t val;
-    uint8_t fw_check[MCU_FW_SIZE];
+    bool match;
     int err = LGW_REG_SUCCESS;
 
     /* Take control over AGC MCU */
@@ -1087,9 +1503,9 @@ int sx1302_agc_load_firmware(const uint8_t *firmware) {
     /* Write AGC fw in AGC MEM */
     err |= lgw_mem_wb(AGC_MEM_ADDR, firmware, MCU_FW_SIZE);
 
-    /* Read back and check */
-    err |= lgw_mem_rb(AGC_MEM_ADDR, fw_check, MCU_FW_SIZE, false);
-    if (memcmp(firmware, fw_check, sizeof fw_check) != 0) {
+    /* Read back a few blocks and check, the parity check below covers the rest */
+    err |= mcu_fw_check_blocks(AGC_MEM_ADDR, firmware, &match);
+    if (match == false) {
         printf("ERROR: AGC fw read/write check failed\n");
         return LGW_REG_ERROR;
     }
@@ -1110,6 +1526,66 @@ int sx1302_agc_load_firmware(const uint8_t *firmware) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_agc_firmware_loaded(const uint8_t *firmware, uint8_t version, bool *loaded) {
+    int32_t val32;
+    uint8_t val = 0;
+    uint8_t status = 0;
+    bool match = false;
+    int i;
+    int err = LGW_REG_SUCCESS;
+
+    CHECK_NULL(firmware);
+    CHECK_NULL(loaded);
+
+    *loaded = false;
+
+    /* Hold AGC MCU in reset and check its memory content */
+    err |= lgw_reg_w(SX1302_REG_AGC_MCU_CTRL_MCU_CLEAR, 0x01);
+    err |= lgw_reg_w(SX1302_REG_AGC_MCU_CTRL_HOST_PROG, 0x01);
+    err |= lgw_reg_w(SX1302_REG_COMMON_PAGE_PAGE, 0x00);
+    err |= mcu_fw_check_blocks(AGC_MEM_ADDR, firmware, &match);
+    if ((err != LGW_REG_SUCCESS) || (match == false)) {
+        DEBUG_MSG("AGC fw not found in memory\n");
+        return err;
+    }
+
+    /* Restart AGC MCU on the firmware already in memory */
+    err |= lgw_reg_w(SX1302_REG_AGC_MCU_CTRL_HOST_PROG, 0x00);
+    err |= lgw_reg_w(SX1302_REG_AGC_MCU_CTRL_MCU_CLEAR, 0x00);
+    err |= lgw_reg_r(SX1302_REG_AGC_MCU_CTRL_PARITY_ERROR, &val32);
+    if ((err != LGW_REG_SUCCESS) || (val32 != 0)) {
+        DEBUG_MSG("AGC fw in memory has parity errors\n");
+        return err;
+    }
+
+    /* Wait for the firmware to publish its VERSION */
+    for (i = 0; i < MCU_FW_BOOT_TIMEOUT_MS; i++) {
+        if (sx1302_agc_status(&status) != LGW_REG_SUCCESS) {
+            return LGW_REG_ERROR;
+        }
+        if (status == 0x01) {
+            break;
+        }
+        wait_ms(1);
+    }
+    if (status != 0x01) {
+        DEBUG_MSG("AGC fw in memory did not start\n");
+        return LGW_REG_SUCCESS;
+    }
+
+    if (sx1302_agc_mailbox_read(0, &val) != LGW_REG_SUCCESS) {
+        return LGW_REG_ERROR;
+    }
+    if (val == version) {
+        DEBUG_PRINTF("AGC fw v%u already loaded\n", val);
+        *loaded = true;
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_agc_status(uint8_t* status) {
     int32_t val;
     int err = LGW_REG_SUCCESS;
@@ -1520,7 +1996,7 @@ int sx1302_agc_start(uint8_t version, uint8_t ana_gain, uint8_t dec_gain) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int sx1302_arb_load_firmware(const uint8_t *firmware) {
-    uint8_t fw_check[MCU_FW_SIZE];
+    bool match;
     int32_t val;
     int err = LGW_REG_SUCCESS;
 
@@ -1532,9 +2008,9 @@ int sx1302_arb_load_firmware(const uint8_t *firmware) {
     /* Write ARB fw in ARB MEM */
     err |= lgw_mem_wb(ARB_MEM_ADDR, &firmware[0], MCU_FW_SIZE);
 
-    /* Read back and check */
-    err |= lgw_mem_rb(ARB_MEM_ADDR, fw_check, MCU_FW_SIZE, false);
-    if (memcmp(firmware, fw_check, sizeof fw_check) != 0) {
+    /* Read back a few blocks and check, the parity check below covers the rest */
+    err |= mcu_fw_check_blocks(ARB_MEM_ADDR, firmware, &match);
+    if (match == false) {
         printf("ERROR: ARB fw read/write check failed\n");
         return LGW_REG_ERROR;
     }
@@ -1555,6 +2031,66 @@ int sx1302_arb_load_firmware(const uint8_t *firmware) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int sx1302_arb_firmware_loaded(const uint8_t *firmware, uint8_t version, bool *loaded) {
+    int32_t val32;
+    uint8_t val = 0;
+    uint8_t status = 0;
+    bool match = false;
+    int i;
+    int err = LGW_REG_SUCCESS;
+
+    CHECK_NULL(firmware);
+    CHECK_NULL(loaded);
+
+    *loaded = false;
+
+    /* Hold ARB MCU in reset and check its memory content */
+    err |= lgw_reg_w(SX1302_REG_ARB_MCU_CTRL_MCU_CLEAR, 0x01);
+    err |= lgw_reg_w(SX1302_REG_ARB_MCU_CTRL_HOST_PROG, 0x01);
+    err |= lgw_reg_w(SX1302_REG_COMMON_PAGE_PAGE, 0x00);
+    err |= mcu_fw_check_blocks(ARB_MEM_ADDR, firmware, &match);
+    if ((err != LGW_REG_SUCCESS) || (match == false)) {
+        DEBUG_MSG("ARB fw not found in memory\n");
+        return err;
+    }
+
+    /* Restart ARB MCU on the firmware already in memory */
+    err |= lgw_reg_w(SX1302_REG_ARB_MCU_CTRL_HOST_PROG, 0x00);
+    err |= lgw_reg_w(SX1302_REG_ARB_MCU_CTRL_MCU_CLEAR, 0x00);
+    err |= lgw_reg_r(SX1302_REG_ARB_MCU_CTRL_PARITY_ERROR, &val32);
+    if ((err != LGW_REG_SUCCESS) || (val32 != 0)) {
+        DEBUG_MSG("ARB fw in memory has parity errors\n");
+        return err;
+    }
+
+    /* Wait for the firmware to publish its VERSION */
+    for (i = 0; i < MCU_FW_BOOT_TIMEOUT_MS; i++) {
+        if (sx1302_arb_status(&status) != LGW_REG_SUCCESS) {
+            return LGW_REG_ERROR;
+        }
+        if (status == 0x01) {
+            break;
+        }
+        wait_ms(1);
+    }
+    if (status != 0x01) {
+        DEBUG_MSG("ARB fw in memory did not start\n");
+        return LGW_REG_SUCCESS;
+    }
+
+    if (sx1302_arb_debug_read(0, &val) != LGW_REG_SUCCESS) {
+        return LGW_REG_ERROR;
+    }
+    if (val == version) {
+        DEBUG_PRINTF("ARB fw v%u already loaded\n", val);
+        *loaded = true;
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 int sx1302_arb_status(uint8_t* status) {
     int32_t val;
     int err = LGW_REG_SUCCESS;
@@ -1737,60 +2273,265 @@ int sx1302_arb_start(uint8_t version) {
 
 int sx1302_fetch(uint8_t * nb_pkt) {
     int err;
-
-    /* Fetch packets from sx1302 if no more left in RX buffer */
-    if (rx_buffer.buffer_pkt_nb == 0) {
-        /* Initialize RX buffer */
-        err = rx_buffer_new(&rx_buffer);
+    rx_buffer_t * cur;
+    rx_buffer_t * next;
+
+    /* Fetch packets from sx1302 into a free RX buffer, the other one may still hold packets to be parsed */
+    cur = rx_buffer_parsed();
+    next = &rx_buffer[rx_buffer_cur ^ 1];
+    if (cur->buffer_pkt_nb == 0) {
+        next = cur;
+    }
+    if (next->buffer_pkt_nb == 0) {
+        /* Reset RX buffer */
+        err = rx_buffer_del(next);
         if (err != LGW_REG_SUCCESS) {
-            printf("ERROR: Failed to initialize RX buffer\n");
+            printf("ERROR: Failed to reset RX buffer\n");
             return LGW_REG_ERROR;
         }
 
         /* Fetch RX buffer if any data available */
-        err = rx_buffer_fetch(&rx_buffer);
+        err = rx_buffer_fetch(next);
         if (err != LGW_REG_SUCCESS) {
             printf("ERROR: Failed to fetch RX buffer\n");
             return LGW_REG_ERROR;
         }
     } else {
-        printf("Note: remaining %u packets in RX buffer, do not fetch sx1302 yet...\n", rx_buffer.buffer_pkt_nb);
+        printf("Note: remaining %u packets in RX buffers, do not fetch sx1302 yet...\n", rx_buffer_pkt_nb());
     }
 
     /* Return the number of packet fetched */
-    *nb_pkt = rx_buffer.buffer_pkt_nb;
+    *nb_pkt = rx_buffer_pkt_nb();
 
     return LGW_REG_SUCCESS;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
+int sx1302_poll(uint8_t * nb_pkt) {
     int err;
-    int ifmod; /* type of if_chain/modem a packet was received by */
+    uint8_t nb_bytes[2][2];
+    uint8_t cnt[2][8];
+    uint32_t inst, pps;
+    uint64_t host_req_us;
+    uint16_t nb_bytes_1, nb_bytes_2;
+    int nb_fetch = 0;
+    rx_buffer_t * cur;
+    rx_buffer_t * next;
+    /* RX buffer byte count and timestamp counters are both read twice (chip workarounds) */
+    const uint16_t poll_reg[4] = {
+        SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES,
+        SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES,
+        SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS,
+        SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS
+    };
+    lgw_com_rb_req_t poll_req[4] = {
+        { 0, nb_bytes[0], 2 },
+        { 0, nb_bytes[1], 2 },
+        { 0, cnt[0], 8 },
+        { 0, cnt[1], 8 }
+    };
+
+    CHECK_NULL(nb_pkt);
+
+    /* Packets left from the previous fetch are parsed first, the next fetch goes to the other RX buffer */
+    cur = rx_buffer_parsed();
+    next = &rx_buffer[rx_buffer_cur ^ 1];
+    if (cur->buffer_pkt_nb == 0) {
+        next = cur;
+    }
+    if (next->buffer_pkt_nb > 0) {
+        printf("Note: remaining %u packets in RX buffers, do not fetch sx1302 yet...\n", rx_buffer_pkt_nb());
+        *nb_pkt = rx_buffer_pkt_nb();
+        return sx1302_update();
+    }
+
+    /* During a burst, the data received meanwhile is read into the other RX buffer without waiting for the next poll */
+    do {
+        err = rx_buffer_del(next);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: Failed to reset RX buffer\n");
+            return LGW_REG_ERROR;
+        }
+
+        /* Byte count is read before the counters, so that the wrapping reference is newer than the packets */
+        host_req_us = timestamp_host_us();
+        err = lgw_reg_rb_multi(poll_reg, poll_req, 4);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: Failed to poll RX buffer and timestamp counter\n");
+            return LGW_REG_ERROR;
+        }
+
+        /* Update internal timestamp counter wrapping status */
+        if (timestamp_counter_process(&counter_us, cnt[0], cnt[1], host_req_us, &inst, &pps) != 0) {
+            return LGW_REG_ERROR;
+        }
+
+        /* Read the RX buffer only if there is something in it */
+        nb_bytes_1 = (nb_bytes[0][0] << 8) | (nb_bytes[0][1] << 0);
+        nb_bytes_2 = (nb_bytes[1][0] << 8) | (nb_bytes[1][1] << 0);
+        if (nb_bytes_2 > nb_bytes_1) {
+            nb_bytes_1 = nb_bytes_2;
+        }
+        rx_fifo_update(nb_bytes_1, inst);
+        err = rx_buffer_load(next, nb_bytes_1);
+        if (err != LGW_REG_SUCCESS) {
+            printf("ERROR: Failed to fetch RX buffer\n");
+            return LGW_REG_ERROR;
+        }
+
+        /* Only the current RX buffer could have been loaded, the other one is free */
+        next = &rx_buffer[rx_buffer_cur ^ 1];
+        nb_fetch += 1;
+    } while ((nb_fetch < 2) && (nb_bytes_1 >= RX_FIFO_FILL_HIGH) && (next->buffer_pkt_nb == 0) && (rx_buffer[rx_buffer_cur].buffer_pkt_nb > 0));
+
+    /* Return the number of packet fetched */
+    *nb_pkt = rx_buffer_pkt_nb();
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_rx_filter_stats(struct lgw_rx_filter_stats_s * stats) {
+    CHECK_NULL(stats);
+
+    *stats = rx_filter_stats;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_rx_buffer_stats(struct lgw_rx_buffer_stats_s * stats) {
+    int i;
+    rx_buffer_stats_t rx_stats;
+
+    CHECK_NULL(stats);
+
+    memset(stats, 0, sizeof *stats);
+    for (i = 0; i < 2; i++) {
+        if (rx_buffer_get_stats(&rx_buffer[i], &rx_stats) != LGW_REG_SUCCESS) {
+            return LGW_REG_ERROR;
+        }
+        stats->nb_resync += rx_stats.nb_resync;
+        stats->nb_bytes_skipped += rx_stats.nb_bytes_skipped;
+        stats->nb_truncated += rx_stats.nb_truncated;
+        stats->nb_checksum_error += rx_stats.nb_checksum_error;
+    }
+
+    stats->nb_poll = rx_fifo.nb_poll;
+    stats->fill_last = rx_fifo.fill_last;
+    stats->fill_peak = rx_fifo.fill_peak;
+    stats->fill_rate = rx_fifo.fill_rate;
+    stats->nb_fifo_full = rx_fifo.nb_fifo_full;
+    stats->nb_poll_gap = rx_fifo.nb_poll_gap;
+    stats->nb_ts_discontinuity = rx_fifo.nb_ts_discontinuity;
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_parse_setup(const lgw_context_t * context) {
+    int i;
     int32_t if_freq_hz;
-    int32_t if_freq_error;
+
+    CHECK_NULL(context);
+
+    /* FSK RSSI linearization polynomial, for every possible raw RSSI */
+    for (i = 0; i < 256; i++) {
+        rssi_fsk_lut[i] = RSSI_FSK_POLY_0 + i * (RSSI_FSK_POLY_1 + i * (RSSI_FSK_POLY_2 + i * RSSI_FSK_POLY_3));
+    }
+
+    for (i = 0; i < LGW_IF_CHAIN_NB; i++) {
+        parse_chain[i].ifmod = ifmod_config[i];
+        parse_chain[i].rf_chain = context->if_chain_cfg[i].rf_chain;
+        if (parse_chain[i].rf_chain >= LGW_RF_CHAIN_NB) {
+            parse_chain[i].rf_chain = 0;
+        }
+
+        /* Get the frequency for the channel configuration */
+        if_freq_hz = context->if_chain_cfg[i].freq_hz; /* The IF frequency set in the registers, is the offset from the zero IF. */
+        parse_chain[i].freq_hz = (uint32_t)((int32_t)context->rf_chain_cfg[parse_chain[i].rf_chain].freq_hz + if_freq_hz);
+
+        /* Channel IF frequency error:
+        When the channel IF frequency has been configured, a precision error may have been introduced
+        due to the register precision. It is added to the frequency offset of each packet.
+            - For a channel set to IF 400000Hz
+            - The IF frequency register will actually be set to 399902Hz due to its resolution
+            - This means that the modem, to shift to 0 IF, will apply -399902, instead of -400000.
+            - This means that the modem will be centered +98hz above the real 0 IF
+            - As the freq_offset given is supposed to be relative to the 0 IF, we add this resolution error to it */
+        parse_chain[i].if_freq_error = if_freq_hz - (IF_HZ_TO_REG(if_freq_hz) * 15625 / 32); /* The error corresponds to how many Hz are missing to get to actual 0 IF. */
+
+        /* Get bandwidth and frequency offset resolution */
+        if (parse_chain[i].ifmod == IF_LORA_MULTI) {
+            parse_chain[i].bandwidth = BW_125KHZ; /* fixed in hardware */
+        } else if (parse_chain[i].ifmod == IF_LORA_STD) {
+            parse_chain[i].bandwidth = context->lora_service_cfg.bandwidth; /* get the parameter from the config variable */
+        } else {
+            parse_chain[i].bandwidth = context->fsk_cfg.bandwidth;
+        }
+        switch (parse_chain[i].bandwidth) {
+            case BW_125KHZ: parse_chain[i].freq_offset_lsb = FREQ_OFFSET_LSB_125KHZ; break;
+            case BW_250KHZ: parse_chain[i].freq_offset_lsb = FREQ_OFFSET_LSB_250KHZ; break;
+            case BW_500KHZ: parse_chain[i].freq_offset_lsb = FREQ_OFFSET_LSB_500KHZ; break;
+            default: parse_chain[i].freq_offset_lsb = 0.0f; break;
+        }
+
+        parse_chain[i].dc_notch_delay = sx1302_dc_notch_delay((double)if_freq_hz / 1E3);
+
+        /* FSK timestamp correction */
+        if (context->fsk_cfg.datarate != 0) {
+            parse_chain[i].fsk_timestamp_correction = ((uint32_t)680000 / context->fsk_cfg.datarate) - 20;
+        } else {
+            parse_chain[i].fsk_timestamp_correction = 0;
+        }
+    }
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_parse_peek_size(uint8_t * size) {
+    return rx_buffer_peek_size(rx_buffer_parsed(), size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_view_s * p) {
+    int err;
+    int ifmod; /* type of if_chain/modem a packet was received by */
     double pkt_freq_error;
     uint16_t payload_crc16_calc;
     uint8_t cr;
     int32_t timestamp_correction;
     rx_packet_t pkt;
+    rx_buffer_t * cur;
 
     /* Check input params */
     CHECK_NULL(context);
     CHECK_NULL(p);
 
     /* get packet from RX buffer */
-    err = rx_buffer_pop(&rx_buffer, &pkt);
+    cur = rx_buffer_parsed();
+    err = rx_buffer_pop(cur, &pkt);
     if (err == LGW_REG_WARNING) {
-        rx_buffer_del(&rx_buffer); /* clear the buffer */
+        rx_buffer_del(cur); /* clear the buffer */
         return err;
     } else if (err == LGW_REG_ERROR) {
         return err;
     }
 
-    /* copy payload to result struct */
-    memcpy((void *)p->payload, (void *)(&(pkt.payload)), pkt.rxbytenb_modem);
+    /* Drop unwanted packets before the costly steps (CRC check, fine timestamp...) */
+    if (rx_filter_accept(context, &pkt) == false) {
+        return SX1302_PKT_FILTERED;
+    }
+
+    /* payload stays in the RX buffer */
+    p->payload = pkt.payload;
     p->size = pkt.rxbytenb_modem;
 
     /* process metadata */
@@ -1800,13 +2541,13 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
         DEBUG_PRINTF("WARNING: %u NOT A VALID IF_CHAIN NUMBER, ABORTING\n", p->if_chain);
         return LGW_REG_ERROR;
     }
-    ifmod = ifmod_config[p->if_chain];
+    ifmod = parse_chain[p->if_chain].ifmod;
     DEBUG_PRINTF("[%d 0x%02X]\n", p->if_chain, ifmod);
 
-    p->rf_chain = (uint8_t)context->if_chain_cfg[p->if_chain].rf_chain;
+    p->rf_chain = parse_chain[p->if_chain].rf_chain;
 
     /* Get the frequency for the channel configuration */
-    p->freq_hz = (uint32_t)((int32_t)context->rf_chain_cfg[p->rf_chain].freq_hz + context->if_chain_cfg[p->if_chain].freq_hz);
+    p->freq_hz = parse_chain[p->if_chain].freq_hz;
 
     /* Get signal strength : offset and temperature compensation will be applied later */
     p->rssic = (float)(pkt.rssi_chan_avg);
@@ -1825,8 +2566,8 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
             } else {
                 p->status = STAT_CRC_OK;
 
-                /* Sanity check of the payload CRC */
-                if (p->size > 0) {
+                /* Sanity check of the payload CRC, unless the SX1302 status is trusted */
+                if ((p->size > 0) && (context->board_cfg.no_crc_check == false)) {
                     payload_crc16_calc = sx1302_lora_payload_crc(p->payload, p->size);
                     if (payload_crc16_calc != pkt.rx_crc16_value) {
                         printf("ERROR: Payload CRC16 check failed (got:0x%04X calc:0x%04X)\n", pkt.rx_crc16_value, payload_crc16_calc);
@@ -1845,11 +2586,7 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
         p->snr = (float)(pkt.snr_average) / 4;
 
         /* Get bandwidth */
-        if (ifmod == IF_LORA_MULTI) {
-            p->bandwidth = BW_125KHZ; /* fixed in hardware */
-        } else {
-            p->bandwidth = context->lora_service_cfg.bandwidth; /* get the parameter from the config variable */
-        }
+        p->bandwidth = parse_chain[p->if_chain].bandwidth;
 
         /* Get datarate */
         switch (pkt.rx_rate_sf) {
@@ -1878,36 +2615,9 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
             default: p->coderate = CR_UNDEFINED;
         }
 
-        /* Get frequency offset in Hz depending on bandwidth */
-        switch (p->bandwidth) {
-            case BW_125KHZ:
-                p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * FREQ_OFFSET_LSB_125KHZ);
-                break;
-            case BW_250KHZ:
-                p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * FREQ_OFFSET_LSB_250KHZ);
-                break;
-            case BW_500KHZ:
-                p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * FREQ_OFFSET_LSB_500KHZ);
-                break;
-            default:
-                p->freq_offset = 0;
-                printf("Invalid frequency offset\n");
-                break;
-        }
-
-        /* Adjust the frequency offset with channel IF frequency error:
-        When the channel IF frequency has been configured, a precision error may have been introduced
-        due to the register precision. We calculate this error here, and adjust the returned frequency error
-        accordingly. */
-        if_freq_hz = context->if_chain_cfg[p->if_chain].freq_hz; /* The IF frequency set in the registers, is the offset from the zero IF. */
-        if_freq_error = if_freq_hz - (IF_HZ_TO_REG(if_freq_hz) * 15625 / 32); /* The error corresponds to how many Hz are missing to get to actual 0 IF. */
-        /* Example to better understand what we get here:
-            - For a channel set to IF 400000Hz
-            - The IF frequency register will actually be set to 399902Hz due to its resolution
-            - This means that the modem, to shift to 0 IF, will apply -399902, instead of -400000.
-            - This means that the modem will be centered +98hz above the real 0 IF
-            - As the freq_offset given is supposed to be relative to the 0 IF, we add this resolution error to it */
-        p->freq_offset += if_freq_error;
+        /* Get frequency offset in Hz depending on bandwidth, adjusted with channel IF frequency error */
+        p->freq_offset = (int32_t)((float)(pkt.frequency_offset_error) * parse_chain[p->if_chain].freq_offset_lsb);
+        p->freq_offset += parse_chain[p->if_chain].if_freq_error;
 
         /* Get timestamp correction to be applied to count_us */
         timestamp_correction = timestamp_counter_correction(context, p->bandwidth, p->datarate, p->coderate, pkt.crc_en, pkt.rxbytenb_modem, RX_DFT_PEAK_MODE_AUTO);
@@ -1920,7 +2630,7 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
             pkt_freq_error = ((double)(p->freq_hz + p->freq_offset) / (double)(p->freq_hz)) - 1.0;
 
             /* Compute the fine timestamp */
-            err = precise_timestamp_calculate(pkt.num_ts_metrics_stored, &pkt.timestamp_avg[0], pkt.timestamp_cnt, pkt.rx_rate_sf, context->if_chain_cfg[p->if_chain].freq_hz, pkt_freq_error, &(p->ftime));
+            err = precise_timestamp_calculate(pkt.num_ts_metrics_stored, pkt.timestamp_avg, pkt.timestamp_cnt, pkt.rx_rate_sf, parse_chain[p->if_chain].dc_notch_delay, pkt_freq_error, &(p->ftime));
             if (err == 0) {
                 p->ftime_received = true;
             }
@@ -1945,14 +2655,14 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
         }
 
         /* Get modulation params */
-        p->bandwidth = context->fsk_cfg.bandwidth;
+        p->bandwidth = parse_chain[p->if_chain].bandwidth;
         p->datarate = context->fsk_cfg.datarate;
 
-        /* Compute timestamp correction to be applied */
-        timestamp_correction = ((uint32_t)680000 / context->fsk_cfg.datarate) - 20;
+        /* Get timestamp correction to be applied */
+        timestamp_correction = parse_chain[p->if_chain].fsk_timestamp_correction;
 
         /* RSSI correction */
-        p->rssic = RSSI_FSK_POLY_0 + RSSI_FSK_POLY_1 * p->rssic + RSSI_FSK_POLY_2 * pow(p->rssic, 2) + RSSI_FSK_POLY_3 * pow(p->rssic, 3);
+        p->rssic = rssi_fsk_lut[pkt.rssi_chan_avg];
 
         /* Undefined for FSK */
         p->coderate = CR_UNDEFINED;
@@ -1976,11 +2686,22 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
     /* Scale 32 MHz packet timestamp to 1 MHz (microseconds) */
     p->count_us = pkt.timestamp_cnt / 32;
 
-    /* Expand 27-bits counter to 32-bits counter, based on current wrapping status (updated after fetch) */
-    p->count_us = timestamp_pkt_expand(&counter_us, p->count_us);
+    /* Expand 27-bits counter to 64-bits counter, based on the counter reference (updated after fetch) */
+    /* (the 32-bits counter is the same value, modulo 2^32) */
+    p->count_us64 = timestamp_counter_expand64(&counter_us, p->count_us);
+    p->count_us = (uint32_t)p->count_us64;
+
+    /* Packets come out in order of reception end: a timestamp far in the past means a lost counter wrap */
+    if ((rx_fifo.last_count_valid == true) && ((int32_t)(rx_fifo.last_count_us - p->count_us) > RX_FIFO_TS_BACKWARD_US)) {
+        rx_fifo.nb_ts_discontinuity += 1;
+        printf("WARNING: packet timestamp %u is %u us before the previous one\n", p->count_us, rx_fifo.last_count_us - p->count_us);
+    }
+    rx_fifo.last_count_us = p->count_us;
+    rx_fifo.last_count_valid = true;
 
     /* Packet timestamp corrected */
-    p->count_us = p->count_us + timestamp_correction;
+    p->count_us64 = p->count_us64 + timestamp_correction;
+    p->count_us = (uint32_t)p->count_us64;
 
     /* Packet CRC status */
     p->crc = pkt.rx_crc16_value;
@@ -1991,15 +2712,29 @@ int sx1302_parse(lgw_context_t * context, struct lgw_pkt_rx_s * p) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 uint16_t sx1302_lora_payload_crc(const uint8_t * data, uint8_t size) {
-    int i;
-    int crc = 0;
+    int i = 0;
+    uint16_t crc = 0;
+
+    if (crc_table_ready == false) {
+        lora_crc16_table_init();
+    }
+
+    /* 8 bytes at a time: crc * x^64 + data, the last 2 bytes need no reduction */
+    for (; (i + 8) <= size; i += 8) {
+        crc = crc_table[7][crc >> 8] ^ crc_table[6][crc & 0xFF] ^
+              crc_table[5][data[i + 0]] ^ crc_table[4][data[i + 1]] ^
+              crc_table[3][data[i + 2]] ^ crc_table[2][data[i + 3]] ^
+              crc_table[1][data[i + 4]] ^ crc_table[0][data[i + 5]] ^
+              (uint16_t)((data[i + 6] << 8) | data[i + 7]);
+    }
 
-    for (i = 0; i < size; i++) {
-        lora_crc16(data[i], &crc);
+    /* Remaining bytes one at a time */
+    for (; i < size; i++) {
+        crc = crc_table[0][crc >> 8] ^ (uint16_t)(((crc & 0xFF) << 8) | data[i]);
     }
 
     //printf("CRC16: 0x%02X 0x%02X (%X)\n", (uint8_t)(crc >> 8), (uint8_t)crc, crc);
-    return (uint16_t)crc;
+    return crc;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -2067,10 +2802,8 @@ float sx1302_rssi_get_temperature_offset(struct lgw_rssi_tcomp_s * context, floa
     DEBUG_PRINTF("       coeff_e: %.3f\n", context->coeff_e);
 
     /* Compute the offset to be applied to RSSI for given temperature */
-    return ((context->coeff_a * pow(temperature, 4)) +
-            (context->coeff_b * pow(temperature, 3)) +
-            (context->coeff_c * pow(temperature, 2)) +
-            (context->coeff_d * temperature) + context->coeff_e) / pow(2, 16);
+    return ((((context->coeff_a * temperature + context->coeff_b) * temperature + context->coeff_c) * temperature +
+            context->coeff_d) * temperature + context->coeff_e) / 65536.0;
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
@@ -2544,7 +3277,8 @@ double sx1302_dc_notch_delay(double if_freq_khz) {
     if ((if_freq_khz < -75.0) || (if_freq_khz > 75.0)) {
         delay = 0.0;
     } else {
-        delay = 1.7e-6 * pow(if_freq_khz, 4) + 2.4e-6 * pow(if_freq_khz, 3) - 0.0101 * pow(if_freq_khz, 2) - 0.01275 * if_freq_khz + 10.2922;
+        /* 1.7e-6*f^4 + 2.4e-6*f^3 - 0.0101*f^2 - 0.01275*f + 10.2922 */
+        delay = (((1.7e-6 * if_freq_khz + 2.4e-6) * if_freq_khz - 0.0101) * if_freq_khz - 0.01275) * if_freq_khz + 10.2922;
     }
 
     /* Number of 32MHz clock cycles */
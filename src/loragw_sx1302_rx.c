@@ -18,7 +18,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 
 #include <stdint.h>     /* C99 types */
 #include <stdio.h>      /* printf fprintf */
-#include <string.h>     /* memset */
+#include <string.h>     /* memset, memchr */
 #include <assert.h>     /* assert */
 
 #include "loragw_aux.h"
@@ -67,6 +67,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define SX1302_PKT_CRC_PAYLOAD_7_0(buffer, start_index)         TAKE_N_BITS_FROM(buffer[start_index + 19], 0, 8)
 #define SX1302_PKT_CRC_PAYLOAD_15_8(buffer, start_index)        TAKE_N_BITS_FROM(buffer[start_index + 20], 0, 8)
 #define SX1302_PKT_NUM_TS_METRICS(buffer, start_index)          TAKE_N_BITS_FROM(buffer[start_index + 21], 0, 8)
+#define SX1302_PKT_TS_METRICS(buffer, start_index)              ((const int8_t *)&buffer[start_index + 22])
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE TYPES -------------------------------------------------------- */
@@ -91,9 +92,35 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
+static uint8_t checksum_calc(const uint8_t * data, uint16_t size);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+static uint8_t checksum_calc(const uint8_t * data, uint16_t size) {
+    int j;
+    uint16_t i = 0;
+    uint32_t sum = 0;
+    uint64_t w, acc;
+
+    /* 8 bytes at a time, in four 16-bit lanes: 64 words cannot overflow a lane */
+    while ((size - i) >= 8) {
+        acc = 0;
+        for (j = 0; (j < 64) && ((size - i) >= 8); j++, i += 8) {
+            memcpy(&w, &data[i], sizeof w);
+            acc += (w & 0x00FF00FF00FF00FFULL) + ((w >> 8) & 0x00FF00FF00FF00FFULL);
+        }
+        sum += (uint32_t)((acc & 0xFFFF) + ((acc >> 16) & 0xFFFF) + ((acc >> 32) & 0xFFFF) + (acc >> 48));
+    }
+
+    /* Remaining bytes */
+    for (; i < size; i++) {
+        sum += data[i];
+    }
+
+    return (uint8_t)sum;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -106,6 +133,8 @@ int rx_buffer_new(rx_buffer_t * self) {
     self->buffer_size = 0;
     self->buffer_index = 0;
     self->buffer_pkt_nb = 0;
+    self->pkt_nb = 0;
+    memset(&self->stats, 0, sizeof self->stats);
 
     return LGW_REG_SUCCESS;
 }
@@ -120,6 +149,7 @@ int rx_buffer_del(rx_buffer_t * self) {
     self->buffer_size = 0;
     self->buffer_index = 0;
     self->buffer_pkt_nb = 0;
+    self->pkt_nb = 0;
 
     return LGW_REG_SUCCESS;
 }
@@ -127,11 +157,7 @@ int rx_buffer_del(rx_buffer_t * self) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int rx_buffer_fetch(rx_buffer_t * self) {
-    int i, res;
     uint8_t buff[2];
-    uint8_t payload_len;
-    uint16_t next_pkt_idx;
-    int idx;
     uint16_t nb_bytes_1, nb_bytes_2;
 
     /* Check input params */
@@ -145,78 +171,133 @@ int rx_buffer_fetch(rx_buffer_t * self) {
     lgw_reg_rb(SX1302_REG_RX_TOP_RX_BUFFER_NB_BYTES_MSB_RX_BUFFER_NB_BYTES, buff, sizeof buff);
     nb_bytes_2 = (buff[0] << 8) | (buff[1] << 0);
 
-    self->buffer_size = (nb_bytes_2 > nb_bytes_1) ? nb_bytes_2 : nb_bytes_1;
+    return rx_buffer_load(self, (nb_bytes_2 > nb_bytes_1) ? nb_bytes_2 : nb_bytes_1);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_buffer_load(rx_buffer_t * self, uint16_t nb_bytes) {
+    int i, res;
+    const uint8_t * sync;
+    uint8_t payload_len, checksum;
+    uint16_t pkt_num_bytes;
+    int idx, skipped;
+    int pkt_end;        /* end of the last valid packet */
+    int truncated_idx;  /* first syncword after pkt_end with a size running past the data, -1 if none */
+
+    /* Check input params */
+    CHECK_NULL(self);
+    if (nb_bytes > sizeof self->buffer) {
+        printf("ERROR: RX buffer holds more bytes than expected (%u)\n", nb_bytes);
+        return LGW_REG_ERROR;
+    }
+
+    self->buffer_size = nb_bytes;
+    self->buffer_index = 0;
+    self->buffer_pkt_nb = 0;
+    self->pkt_nb = 0;
 
     /* Fetch bytes from fifo if any */
-    if (self->buffer_size > 0) {
-        DEBUG_MSG   ("-----------------\n");
-        DEBUG_PRINTF("%s: nb_bytes to be fetched: %u (%u %u)\n", __FUNCTION__, self->buffer_size, buff[1], buff[0]);
-
-        memset(self->buffer, 0, sizeof self->buffer);
-        res = lgw_mem_rb(0x4000, self->buffer, self->buffer_size, true);
-        if (res != LGW_REG_SUCCESS) {
-            printf("ERROR: Failed to read RX buffer, SPI error\n");
-            return LGW_REG_ERROR;
-        }
+    if (self->buffer_size == 0) {
+        return LGW_REG_SUCCESS;
+    }
 
-        /* print debug info */
-        DEBUG_MSG("RX_BUFFER: ");
-        for (i = 0; i < self->buffer_size; i++) {
-            DEBUG_PRINTF("%02X ", self->buffer[i]);
-        }
-        DEBUG_MSG("\n");
+    DEBUG_MSG   ("-----------------\n");
+    DEBUG_PRINTF("%s: nb_bytes to be fetched: %u\n", __FUNCTION__, self->buffer_size);
 
-        /* Sanity check: is there at least 1 complete packet in the buffer */
-        if (self->buffer_size < (SX1302_PKT_HEAD_METADATA + SX1302_PKT_TAIL_METADATA)) {
-            printf("WARNING: not enough data to have a complete packet, discard rx_buffer\n");
-            return rx_buffer_del(self);
+    res = lgw_mem_rb(0x4000, self->buffer, self->buffer_size, true);
+    if (res != LGW_REG_SUCCESS) {
+        printf("ERROR: Failed to read RX buffer, SPI error\n");
+        return LGW_REG_ERROR;
+    }
+
+    /* print debug info */
+    DEBUG_MSG("RX_BUFFER: ");
+    for (i = 0; i < self->buffer_size; i++) {
+        DEBUG_PRINTF("%02X ", self->buffer[i]);
+    }
+    DEBUG_MSG("\n");
+
+    /* Single pass: find syncword, check the packet fits and its checksum, index it, jump over it */
+    idx = 0;
+    skipped = 0;
+    pkt_end = 0;
+    truncated_idx = -1;
+    while ((idx + 1) < self->buffer_size) {
+        /* Look for the syncword first byte, the second one must be in the buffer too */
+        sync = memchr(&self->buffer[idx], SX1302_PKT_SYNCWORD_BYTE_0, self->buffer_size - idx - 1);
+        if (sync == NULL) {
+            skipped += self->buffer_size - idx;
+            idx = self->buffer_size;
+            break;
+        }
+        skipped += (int)(sync - &self->buffer[idx]);
+        idx = (int)(sync - self->buffer);
+        if (self->buffer[idx + 1] != SX1302_PKT_SYNCWORD_BYTE_1) {
+            skipped += 1;
+            idx += 1;
+            continue;
         }
 
-        /* Sanity check: is there a syncword at 0 ? If not, move to the first syncword found */
-        idx = 0;
-        while (idx <= (self->buffer_size - 2)) {
-            if ((self->buffer[idx] == SX1302_PKT_SYNCWORD_BYTE_0) && (self->buffer[idx + 1] == SX1302_PKT_SYNCWORD_BYTE_1)) {
-                DEBUG_PRINTF("INFO: syncword found at idx %d\n", idx);
-                break;
-            } else {
-                printf("INFO: syncword not found at idx %d\n", idx);
-                idx += 1;
-            }
+        /* Check the packet is complete. If not, it is the last record cut by the end of the data,
+           or a spurious syncword with a garbage size: resync as for a checksum error and decide at the end */
+        payload_len = SX1302_PKT_PAYLOAD_LENGTH(self->buffer, idx);
+        pkt_num_bytes = 0;
+        if ((idx + SX1302_PKT_HEAD_METADATA + payload_len + SX1302_PKT_TAIL_METADATA) <= self->buffer_size) {
+            pkt_num_bytes = SX1302_PKT_HEAD_METADATA + payload_len + SX1302_PKT_TAIL_METADATA + (2 * SX1302_PKT_NUM_TS_METRICS(self->buffer, idx + payload_len));
         }
-        if (idx > self->buffer_size - 2) {
-            printf("WARNING: no syncword found, discard rx_buffer\n");
-            return rx_buffer_del(self);
+        if ((pkt_num_bytes == 0) || ((idx + pkt_num_bytes) > self->buffer_size)) {
+            if (truncated_idx < 0) {
+                truncated_idx = idx;
+            }
+            skipped += 1;
+            idx += 1;
+            continue;
         }
-        if (idx != 0) {
-            printf("INFO: re-sync rx_buffer at idx %d\n", idx);
-            memmove((void *)(self->buffer), (void *)(self->buffer + idx), self->buffer_size - idx);
-            self->buffer_size -= idx;
+
+        /* Check the checksum, over all bytes but the last one */
+        checksum = checksum_calc(&self->buffer[idx], pkt_num_bytes - 1);
+        if (checksum != self->buffer[idx + pkt_num_bytes - 1]) {
+            /* Not a packet, or a corrupted one: look for the next syncword */
+            self->stats.nb_checksum_error += 1;
+            DEBUG_PRINTF("WARNING: checksum failed at idx %d (got:0x%02X calc:0x%02X)\n", idx, self->buffer[idx + pkt_num_bytes - 1], checksum);
+            skipped += 1;
+            idx += 1;
+            continue;
         }
 
-        /* Rewind and parse buffer to get the number of packet fetched */
-        idx = 0;
-        while (idx < self->buffer_size) {
-            if ((self->buffer[idx] != SX1302_PKT_SYNCWORD_BYTE_0) || (self->buffer[idx + 1] != SX1302_PKT_SYNCWORD_BYTE_1)) {
-                printf("WARNING: syncword not found at idx %d, discard the rx_buffer\n", idx);
-                return rx_buffer_del(self);
-            }
-            /* One packet found in the buffer */
-            self->buffer_pkt_nb += 1;
-
-            /* Compute the number of bytes for this packet */
-            payload_len = SX1302_PKT_PAYLOAD_LENGTH(self->buffer, idx);
-            next_pkt_idx =  SX1302_PKT_HEAD_METADATA +
-                            payload_len +
-                            SX1302_PKT_TAIL_METADATA +
-                            (2 * SX1302_PKT_NUM_TS_METRICS(self->buffer, idx + payload_len));
-
-            /* Move to next packet */
-            idx += (int)next_pkt_idx;
+        /* Valid packet, any size running past the data before it was spurious */
+        truncated_idx = -1;
+        if (skipped > 0) {
+            self->stats.nb_resync += 1;
+            self->stats.nb_bytes_skipped += skipped;
+            DEBUG_PRINTF("INFO: re-sync rx_buffer at idx %d (%d bytes skipped)\n", idx, skipped);
+            skipped = 0;
+        }
+        if (self->pkt_nb >= RX_BUFFER_PKT_NB_MAX) {
+            break; /* cannot happen, packets are at least 23 bytes */
         }
+        self->pkt_offset[self->pkt_nb] = (uint16_t)idx;
+        self->pkt_nb += 1;
+        idx += pkt_num_bytes;
+        pkt_end = idx;
+    }
+    if (truncated_idx >= 0) {
+        /* No packet after it: the record was really cut, its bytes are not skipped garbage */
+        self->stats.nb_truncated += 1;
+        DEBUG_PRINTF("WARNING: truncated packet at idx %d (size=%u)\n", truncated_idx, self->buffer_size);
+        skipped = truncated_idx - pkt_end;
+    }
+    if (skipped > 0) {
+        self->stats.nb_resync += 1;
+        self->stats.nb_bytes_skipped += skipped;
+        DEBUG_PRINTF("INFO: no more syncword in rx_buffer (%d bytes skipped)\n", skipped);
     }
 
-    /* Initialize the current buffer index to iterate on */
-    self->buffer_index = 0;
+    self->buffer_pkt_nb = self->pkt_nb;
+    if (self->pkt_nb > 0) {
+        self->buffer_index = self->pkt_offset[0];
+    }
 
     return LGW_REG_SUCCESS;
 }
@@ -225,24 +306,19 @@ int rx_buffer_fetch(rx_buffer_t * self) {
 
 int rx_buffer_pop(rx_buffer_t * self, rx_packet_t * pkt) {
     int i;
-    uint8_t checksum_rcv, checksum_calc = 0;
-    uint16_t checksum_idx;
-    uint16_t pkt_num_bytes;
 
     /* Check input params */
     CHECK_NULL(self);
     CHECK_NULL(pkt);
 
-    /* Is there any data to be parsed ? */
-    if (self->buffer_index >= self->buffer_size) {
+    /* Is there any packet to be parsed ? */
+    if (self->buffer_pkt_nb == 0) {
         DEBUG_MSG("INFO: No more data to be parsed\n");
         return LGW_REG_ERROR;
     }
 
-    /* Get pkt sync words */
-    if ((self->buffer[self->buffer_index] != SX1302_PKT_SYNCWORD_BYTE_0) || (self->buffer[self->buffer_index + 1] != SX1302_PKT_SYNCWORD_BYTE_1)) {
-        return LGW_REG_ERROR;
-    }
+    /* Syncword, size and checksum have been checked by rx_buffer_load() */
+    self->buffer_index = self->pkt_offset[self->pkt_nb - self->buffer_pkt_nb];
     DEBUG_PRINTF("INFO: pkt syncword found at index %u\n", self->buffer_index);
 
     /* Get payload length */
@@ -251,32 +327,6 @@ int rx_buffer_pop(rx_buffer_t * self, rx_packet_t * pkt) {
     /* Get fine timestamp metrics */
     pkt->num_ts_metrics_stored = SX1302_PKT_NUM_TS_METRICS(self->buffer, self->buffer_index + pkt->rxbytenb_modem);
 
-    /* Calculate the total number of bytes in the packet */
-    pkt_num_bytes = SX1302_PKT_HEAD_METADATA + pkt->rxbytenb_modem + SX1302_PKT_TAIL_METADATA + (2 * pkt->num_ts_metrics_stored);
-
-    /* Check if we have a complete packet in the rx buffer fetched */
-    if((self->buffer_index + pkt_num_bytes) > self->buffer_size) {
-        printf("WARNING: aborting truncated message (size=%u)\n", self->buffer_size);
-        return LGW_REG_WARNING;
-    }
-
-    /* Get the checksum as received in the RX buffer */
-    checksum_idx = pkt_num_bytes - 1;
-    checksum_rcv = self->buffer[self->buffer_index + pkt_num_bytes - 1];
-
-    /* Calculate the checksum from the actual payload bytes received */
-    for (i = 0; i < (int)checksum_idx; i++) {
-        checksum_calc += self->buffer[self->buffer_index + i];
-    }
-
-    /* Check if the checksum is correct */
-    if (checksum_rcv != checksum_calc) {
-        printf("WARNING: checksum failed (got:0x%02X calc:0x%02X)\n", checksum_rcv, checksum_calc);
-        return LGW_REG_WARNING;
-    } else {
-        DEBUG_PRINTF("Packet checksum OK (0x%02X)\n", checksum_rcv);
-    }
-
     /* Parse packet metadata */
     pkt->modem_id = SX1302_PKT_MODEM_ID(self->buffer, self->buffer_index);
     pkt->rx_channel_in = SX1302_PKT_CHANNEL(self->buffer, self->buffer_index);
@@ -305,10 +355,7 @@ int rx_buffer_pop(rx_buffer_t * self, rx_packet_t * pkt) {
     pkt->timestamp_cnt |= (uint32_t)((SX1302_PKT_TIMESTAMP_31_24(self->buffer, self->buffer_index + pkt->rxbytenb_modem) << 24) & 0xFF000000);
 
     /* TS metrics: it is expected the nb_symbols parameter is set to 0 here */
-    for (i = 0; i < (pkt->num_ts_metrics_stored * 2); i++) {
-        pkt->timestamp_avg[i] = (int8_t)SX1302_PKT_NUM_TS_METRICS(self->buffer, self->buffer_index + pkt->rxbytenb_modem + 1 + i);
-        pkt->timestamp_stddev[i] = 0; /* no stddev when nb_symbols == 0 */
-    }
+    pkt->timestamp_avg = SX1302_PKT_TS_METRICS(self->buffer, self->buffer_index + pkt->rxbytenb_modem);
 
     DEBUG_MSG   ("-----------------\n");
     DEBUG_PRINTF("  modem:      %u\n", pkt->modem_id);
@@ -351,11 +398,8 @@ int rx_buffer_pop(rx_buffer_t * self, rx_packet_t * pkt) {
         }
     }
 
-    /* Parse & copy payload in packet struct */
-    memcpy((void *)pkt->payload, (void *)(&(self->buffer[self->buffer_index + SX1302_PKT_HEAD_METADATA])), pkt->rxbytenb_modem);
-
-    /* Move buffer index toward next message */
-    self->buffer_index += (SX1302_PKT_HEAD_METADATA + pkt->rxbytenb_modem + SX1302_PKT_TAIL_METADATA + (2 * pkt->num_ts_metrics_stored));
+    /* Point to the payload in the buffer, no copy */
+    pkt->payload = &(self->buffer[self->buffer_index + SX1302_PKT_HEAD_METADATA]);
 
     /* Update the number of packets currently stored in the rx_buffer */
     self->buffer_pkt_nb -= 1;
@@ -363,4 +407,31 @@ int rx_buffer_pop(rx_buffer_t * self, rx_packet_t * pkt) {
     return LGW_REG_SUCCESS;
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_buffer_peek_size(const rx_buffer_t * self, uint8_t * size) {
+    /* Check input params */
+    CHECK_NULL(self);
+    CHECK_NULL(size);
+
+    if (self->buffer_pkt_nb == 0) {
+        return LGW_REG_ERROR;
+    }
+    *size = SX1302_PKT_PAYLOAD_LENGTH(self->buffer, self->pkt_offset[self->pkt_nb - self->buffer_pkt_nb]);
+
+    return LGW_REG_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int rx_buffer_get_stats(rx_buffer_t * self, rx_buffer_stats_t * stats) {
+    /* Check input params */
+    CHECK_NULL(self);
+    CHECK_NULL(stats);
+
+    *stats = self->stats;
+
+    return LGW_REG_SUCCESS;
+}
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -21,12 +21,21 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
 #include <stdint.h>     /* C99 types */
 #include <stdbool.h>    /* boolean type */
 #include <stdio.h>      /* printf fprintf */
 #include <memory.h>     /* memset */
 #include <inttypes.h>   /* PRIx64, PRIu64... */
 #include <assert.h>
+#include <time.h>       /* clock_gettime */
+#include <math.h>       /* sqrt */
 
 #include "loragw_sx1302_timestamp.h"
 #include "loragw_reg.h"
@@ -56,15 +65,39 @@ struct timestamp_pps_history_s {
     uint8_t size; /* current size */
 };
 
+/* Scalar Kalman filter of the crystal correction factor (true time / counter time), updated on each PPS */
+struct timestamp_xtal_s {
+    bool valid;             /* at least one PPS interval was measured */
+    uint32_t pps_last;      /* 32 MHz counter of the last PPS seen */
+    uint32_t nb_pps;        /* number of PPS seen since the reset */
+    uint8_t nb_reject;      /* consecutive PPS intervals rejected */
+    double correct;         /* estimated correction factor */
+    double var;             /* variance of the estimation */
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS ---------------------------------------------------- */
 
 #define PRECISION_TIMESTAMP_TS_METRICS_MAX  32 /* reduce number of metrics to better match GW v2 fine timestamp (max is 255) */
 #define PRECISION_TIMESTAMP_NB_SYMBOLS      0
 
+#define TIMESTAMP_MODEL_SPACING_US  1000000     /* minimum host time between two samples of the counter rate fit */
+#define TIMESTAMP_MODEL_AGE_MAX_US  60000000    /* beyond, the counter must be read again to be estimated */
+#define TIMESTAMP_MODEL_RATE_TOL    200e-6      /* counter rate tolerance against the host clock (crystal + host clock slew) */
+#define TIMESTAMP_MODEL_RATE_WANDER 1e-6        /* counter rate change over the fit window (temperature) */
+
+#define TIMESTAMP_XTAL_TOL          100e-6      /* PPS intervals further from nominal are rejected */
+#define TIMESTAMP_XTAL_PPS_JITTER   2.0         /* PPS edge jitter plus counter resolution, in 32 MHz cycles */
+#define TIMESTAMP_XTAL_WANDER       1e-9        /* crystal correction change per second, standard deviation */
+#define TIMESTAMP_XTAL_REJECT_MAX   3           /* consecutive rejected PPS intervals before restarting the filter */
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES ---------------------------------------------------- */
 
+/* legacy_timestamp_correction() results in RX_DFT_PEAK_MODE_AUTO, by [bandwidth][sf][cr][crc_en][payload_length],
+   0 until computed (a correction is never 0) */
+static int32_t timestamp_correction_memo[3][8][4][2][256];
+
 /* history of the last PPS timestamps */
 static struct timestamp_pps_history_s timestamp_pps_history = {
     .history = { 0 },
@@ -72,6 +105,16 @@ static struct timestamp_pps_history_s timestamp_pps_history = {
     .size = 0
 };
 
+/* crystal correction tracked from the PPS */
+static struct timestamp_xtal_s timestamp_xtal = {
+    .valid = false,
+    .pps_last = 0,
+    .nb_pps = 0,
+    .nb_reject = 0,
+    .correct = 1.0,
+    .var = 0.0
+};
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
 
@@ -91,6 +134,16 @@ Returns the correction to be applied to the packet timestamp, in microseconds
 */
 void timestamp_pps_history_save(uint32_t timestamp_pps_reg);
 
+/**
+Updates the crystal correction estimation with a new PPS
+*/
+void timestamp_xtal_update(uint32_t timestamp_pps_reg);
+
+/**
+Adds the current counter reference to the samples of the rate fit, and fits the rate again
+*/
+void timestamp_model_add(timestamp_counter_t * self);
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -267,9 +320,109 @@ void timestamp_pps_history_save(uint32_t timestamp_pps_reg) {
         if (timestamp_pps_history.size < MAX_TIMESTAMP_PPS_HISTORY) {
             timestamp_pps_history.size += 1;
         }
+
+        timestamp_xtal_update(timestamp_pps_reg);
     }
 }
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void timestamp_xtal_update(uint32_t timestamp_pps_reg) {
+    struct timestamp_xtal_s * xtal = &timestamp_xtal;
+    uint32_t diff_pps;
+    double nb_s, dev, z, r, k;
+
+    xtal->nb_pps += 1;
+    diff_pps = timestamp_pps_reg - xtal->pps_last;
+    xtal->pps_last = timestamp_pps_reg;
+    if (xtal->nb_pps < 2) {
+        return;
+    }
+
+    /* Counter polled slower than the PPS: the interval spans several seconds */
+    nb_s = (double)(uint32_t)(((double)diff_pps / 32e6) + 0.5);
+    dev = (nb_s > 0.0) ? ((double)diff_pps / (nb_s * 32e6) - 1.0) : 1.0;
+    if ((dev > TIMESTAMP_XTAL_TOL) || (dev < -TIMESTAMP_XTAL_TOL)) {
+        DEBUG_PRINTF("INFO: PPS interval of %u cycles rejected\n", diff_pps);
+        xtal->nb_reject += 1;
+        if (xtal->nb_reject >= TIMESTAMP_XTAL_REJECT_MAX) {
+            printf("WARNING: PPS intervals out of crystal tolerance, restarting crystal correction tracking\n");
+            xtal->valid = false;
+            xtal->nb_reject = 0;
+        }
+        return;
+    }
+    xtal->nb_reject = 0;
+
+    /* Measurement, with the jitter of both PPS edges */
+    z = (nb_s * 32e6) / (double)diff_pps;
+    r = (2.0 * TIMESTAMP_XTAL_PPS_JITTER) / (nb_s * 32e6);
+    r *= r;
+
+    if (xtal->valid == false) {
+        xtal->correct = z;
+        xtal->var = r;
+        xtal->valid = true;
+    } else {
+        xtal->var += TIMESTAMP_XTAL_WANDER * TIMESTAMP_XTAL_WANDER * nb_s;
+        k = xtal->var / (xtal->var + r);
+        xtal->correct += k * (z - xtal->correct);
+        xtal->var *= (1.0 - k);
+    }
+    DEBUG_PRINTF("INFO: crystal correction %.4f ppm (+/- %.4f ppm), PPS measure %.4f ppm\n", (xtal->correct - 1.0) * 1E6, sqrt(xtal->var) * 1E6, (z - 1.0) * 1E6);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+void timestamp_model_add(timestamp_counter_t * self) {
+    struct timestamp_model_s * model = &self->model;
+    uint8_t first, last;
+    double span, rate, rate_dev;
+
+    /* Samples are spaced out for the rate fit, closer reads only move the reference */
+    if (model->size > 0) {
+        last = (model->idx + TIMESTAMP_MODEL_SAMPLE_NB - 1) % TIMESTAMP_MODEL_SAMPLE_NB;
+        if ((self->host_ref_us - model->host_us[last]) < TIMESTAMP_MODEL_SPACING_US) {
+            return;
+        }
+    }
+
+    model->host_us[model->idx] = self->host_ref_us;
+    model->cnt_us[model->idx] = self->inst_us_64bits;
+    model->jitter_us[model->idx] = self->host_ref_jitter_us;
+    last = model->idx;
+    model->idx = (model->idx + 1) % TIMESTAMP_MODEL_SAMPLE_NB;
+    if (model->size < TIMESTAMP_MODEL_SAMPLE_NB) {
+        model->size += 1;
+    }
+
+    /* Rate between the oldest and the newest samples, the read jitter of both is spread over the span */
+    rate = 1.0;
+    rate_dev = 0.0;
+    if (model->size > 1) {
+        first = (model->size < TIMESTAMP_MODEL_SAMPLE_NB) ? 0 : model->idx;
+        span = (double)(model->host_us[last] - model->host_us[first]);
+        rate = (double)(model->cnt_us[last] - model->cnt_us[first]) / span;
+        rate_dev = (rate > 1.0) ? (rate - 1.0) : (1.0 - rate);
+        if (rate_dev <= TIMESTAMP_MODEL_RATE_TOL) {
+            model->rate = rate;
+            model->rate_err = (double)(model->jitter_us[first] + model->jitter_us[last]) / span + TIMESTAMP_MODEL_RATE_WANDER;
+            DEBUG_PRINTF("INFO: counter rate %.3f ppm +/- %.3f ppm over %.0f us\n", (rate - 1.0) * 1E6, model->rate_err * 1E6, span);
+            return;
+        }
+
+        /* Host clock stopped (suspend) or counter jumped: restart the fit from this sample */
+        printf("WARNING: counter rate %.1f ppm off the host clock, restarting the fit\n", (rate - 1.0) * 1E6);
+        model->host_us[0] = model->host_us[last];
+        model->cnt_us[0] = model->cnt_us[last];
+        model->jitter_us[0] = model->jitter_us[last];
+        model->idx = 1;
+        model->size = 1;
+    }
+    model->rate = 1.0;
+    model->rate_err = TIMESTAMP_MODEL_RATE_TOL;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
@@ -285,18 +438,37 @@ void timestamp_counter_delete(timestamp_counter_t * self) {
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-void timestamp_counter_update(timestamp_counter_t * self, uint32_t pps, uint32_t inst) {
+void timestamp_counter_update(timestamp_counter_t * self, uint32_t pps, uint32_t inst, uint64_t host_req_us) {
     //struct timestamp_info_s* tinfo = (pps == true) ? &self->pps : &self->inst;
+    uint64_t now_us;
+    uint64_t host_us;
+    uint64_t delta_us;
 
     /* Check if counter has wrapped, and update wrap status if necessary */
     if (pps < self->pps.counter_us_27bits_ref) {
         self->pps.counter_us_27bits_wrap += 1;
         self->pps.counter_us_27bits_wrap %= 32;
     }
-    if (inst < self->inst.counter_us_27bits_ref) {
-        self->inst.counter_us_27bits_wrap += 1;
-        self->inst.counter_us_27bits_wrap %= 32;
+
+    /* The counter was latched somewhere during the register read: take the middle of it as host time */
+    now_us = timestamp_host_us();
+    if ((host_req_us == 0) || (host_req_us > now_us)) {
+        host_req_us = now_us;
     }
+    host_us = host_req_us + (now_us - host_req_us) / 2;
+
+    /* The counter went forward by less than a wrap, unless the host clock says it has been longer */
+    delta_us = (inst - self->inst.counter_us_27bits_ref) & 0x07FFFFFF;
+    if ((self->host_ref_us != 0) && (host_us > self->host_ref_us)) {
+        if ((host_us - self->host_ref_us) > (delta_us + (1 << 26))) {
+            delta_us += (((host_us - self->host_ref_us) - delta_us + (1 << 26)) >> 27) << 27;
+        }
+    }
+    self->inst_us_64bits += delta_us;
+    self->inst.counter_us_27bits_wrap = (uint8_t)((self->inst_us_64bits >> 27) & 0x1F);
+    self->host_ref_us = host_us;
+    self->host_ref_jitter_us = (uint32_t)((now_us - host_req_us + 1) / 2);
+    timestamp_model_add(self);
 
     /* Update counter reference */
     self->pps.counter_us_27bits_ref = pps;
@@ -309,35 +481,46 @@ int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t
     int x;
     uint8_t buff[8];
     uint8_t buff_wa[8];
-    uint32_t counter_inst_us_raw_27bits_now;
-    uint32_t counter_pps_us_raw_27bits_now;
+    uint64_t host_req_us;
 
     /* Get the freerun and pps 32MHz timestamp counters - 8 bytes
             0 -> 3 : PPS counter
             4 -> 7 : Freerun counter (inst)
     */
+    host_req_us = timestamp_host_us();
     x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, &buff[0], 8);
     if (x != LGW_REG_SUCCESS) {
         printf("ERROR: Failed to get timestamp counter value\n");
         return -1;
     }
 
-    /* Workaround concentrator chip issue:
-        - read MSB again
-        - if MSB changed, read the full counter again
-     */
+    /* Workaround concentrator chip issue: read MSB again (see timestamp_counter_process()) */
     x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, &buff_wa[0], 8);
     if (x != LGW_REG_SUCCESS) {
         printf("ERROR: Failed to get timestamp counter MSB value\n");
         return -1;
     }
+
+    return timestamp_counter_process(self, buff, buff_wa, host_req_us, inst, pps);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int timestamp_counter_process(timestamp_counter_t * self, uint8_t * buff, const uint8_t * buff_wa, uint64_t host_req_us, uint32_t * inst, uint32_t * pps) {
+    int x;
+    uint32_t counter_inst_us_raw_27bits_now;
+    uint32_t counter_pps_us_raw_27bits_now;
+
+    /* Workaround concentrator chip issue:
+        - read MSB again
+        - if MSB changed, read the full counter again
+     */
     if ((buff[0] != buff_wa[0]) || (buff[4] != buff_wa[4])) {
-        x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, &buff_wa[0], 8);
+        x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS, &buff[0], 8); /* use the new read value */
         if (x != LGW_REG_SUCCESS) {
             printf("ERROR: Failed to get timestamp counter MSB value\n");
             return -1;
         }
-        memcpy(buff, buff_wa, 8); /* use the new read value */
     }
 
     counter_pps_us_raw_27bits_now  = (buff[0]<<24) | (buff[1]<<16) | (buff[2]<<8) | buff[3];
@@ -351,7 +534,7 @@ int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t
     counter_inst_us_raw_27bits_now /= 32;
 
     /* Update counter wrapping status */
-    timestamp_counter_update(self, counter_pps_us_raw_27bits_now, counter_inst_us_raw_27bits_now);
+    timestamp_counter_update(self, counter_pps_us_raw_27bits_now, counter_inst_us_raw_27bits_now, host_req_us);
 
     /* Convert 27-bits counter to 32-bits counter */
     *inst = timestamp_counter_expand(self, false, counter_inst_us_raw_27bits_now);
@@ -362,6 +545,55 @@ int timestamp_counter_get(timestamp_counter_t * self, uint32_t * inst, uint32_t
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
+int timestamp_xtal_correct(double * xtal_correct, double * sigma_ppm) {
+    CHECK_NULL(xtal_correct);
+    CHECK_NULL(sigma_ppm);
+
+    if (timestamp_xtal.valid == false) {
+        return -1;
+    }
+    *xtal_correct = timestamp_xtal.correct;
+    *sigma_ppm = sqrt(timestamp_xtal.var) * 1E6;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t timestamp_host_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    /* 0 is kept for "never read" */
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000 + 1;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int timestamp_counter_estimate(timestamp_counter_t * self, uint64_t host_us, uint64_t * cnt_us, uint32_t * err_us) {
+    uint64_t elapsed_us;
+
+    CHECK_NULL(self);
+    CHECK_NULL(cnt_us);
+    CHECK_NULL(err_us);
+
+    if ((self->host_ref_us == 0) || (host_us < self->host_ref_us)) {
+        return -1;
+    }
+    elapsed_us = host_us - self->host_ref_us;
+    if (elapsed_us > TIMESTAMP_MODEL_AGE_MAX_US) {
+        return -1;
+    }
+
+    *cnt_us = self->inst_us_64bits + (uint64_t)((double)elapsed_us * self->model.rate + 0.5);
+    *err_us = self->host_ref_jitter_us + (uint32_t)((double)elapsed_us * self->model.rate_err) + 1;
+
+    return 0;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
 uint32_t timestamp_counter_expand(timestamp_counter_t * self, bool pps, uint32_t cnt_us) {
     struct timestamp_info_s* tinfo = (pps == true) ? &self->pps : &self->inst;
     uint32_t counter_us_32bits;
@@ -372,6 +604,13 @@ uint32_t timestamp_counter_expand(timestamp_counter_t * self, bool pps, uint32_t
 }
 
 
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+uint64_t timestamp_counter_expand64(timestamp_counter_t * self, uint32_t cnt_us) {
+    /* Packet and PPS timestamps are latches of the instantaneous counter, taken before the reference */
+    return self->inst_us_64bits - ((self->inst.counter_us_27bits_ref - cnt_us) & 0x07FFFFFF);
+}
+
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 uint32_t timestamp_pkt_expand(timestamp_counter_t * self, uint32_t pkt_cnt_us) {
@@ -412,6 +651,8 @@ int timestamp_counter_mode(void) {
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
 int32_t timestamp_counter_correction(lgw_context_t * context, uint8_t bandwidth, uint8_t datarate, uint8_t coderate, bool crc_en, uint8_t payload_length, sx1302_rx_dft_peak_mode_t dft_peak_mode) {
+    int32_t * memo;
+
     /* Check input parameters */
     CHECK_NULL(context);
     if (IS_LORA_DR(datarate) == false) {
@@ -427,34 +668,40 @@ int32_t timestamp_counter_correction(lgw_context_t * context, uint8_t bandwidth,
         return 0;
     }
 
-    /* Calculate the correction to be applied */
+    /* Calculate the correction to be applied, once for each set of packet parameters */
+    if (dft_peak_mode == RX_DFT_PEAK_MODE_AUTO) {
+        memo = &timestamp_correction_memo[bandwidth - BW_125KHZ][datarate - DR_LORA_SF5][coderate - CR_LORA_4_5][crc_en ? 1 : 0][payload_length];
+        if (*memo == 0) {
+            *memo = legacy_timestamp_correction(bandwidth, datarate, coderate, crc_en, payload_length, dft_peak_mode);
+        }
+        return *memo;
+    }
     return legacy_timestamp_correction(bandwidth, datarate, coderate, crc_en, payload_length, dft_peak_mode);
 }
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
-int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics, uint32_t timestamp_cnt, uint8_t sf, int32_t if_freq_hz, double pkt_freq_error, uint32_t * result_ftime) {
-    int i, x, timestamp_pps_idx, timestamp_pps_idx_next, timestamp_pps_idx_prev;
+int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics, uint32_t timestamp_cnt, uint8_t sf, double dc_notch_delay, double pkt_freq_error, uint32_t * result_ftime) {
+    int i, n, timestamp_pps_idx;
     int32_t ftime_sum;
-    int32_t ftime[256];
     float ftime_mean;
     uint32_t timestamp_cnt_end_of_preamble;
     uint32_t timestamp_pps = 0;
     uint32_t timestamp_pps_reg = 0;
     uint32_t offset_preamble_hdr;
-    uint8_t buff[4];
     uint32_t diff_pps;
     double pkt_ftime;
     uint8_t ts_metrics_nb_clipped;
     double xtal_correct;
+    double xtal_sigma_ppm;
 
     /* Check input parameters */
     CHECK_NULL(ts_metrics);
     CHECK_NULL(result_ftime);
 
-    /* Check if we can calculate a ftime */
-    if (timestamp_pps_history.size < MAX_TIMESTAMP_PPS_HISTORY) {
-        printf("INFO: Cannot compute ftime yet, PPS history is too short\n");
+    /* Check if we can calculate a ftime: the crystal correction needs two PPS */
+    if (timestamp_xtal_correct(&xtal_correct, &xtal_sigma_ppm) != 0) {
+        printf("INFO: Cannot compute ftime yet, no crystal correction from PPS\n");
         return -1;
     }
 
@@ -486,30 +733,20 @@ int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics
             break;
     }
 
-    /* Compute the ftime cumulative sum */
-    ftime[0] = (int32_t)ts_metrics[0];
-    ftime_sum = ftime[0];
-    for (i = 1; i < (2 * ts_metrics_nb_clipped); i++) {
-        ftime[i] = ftime[i-1] + ts_metrics[i];
-        ftime_sum += ftime[i];
+    /* Compute the sum of the ftime cumulative sum: metric i is counted (n - i) times.
+       No dependency between iterations, so the compiler can vectorize it */
+    n = 2 * ts_metrics_nb_clipped;
+    ftime_sum = 0;
+    for (i = 0; i < n; i++) {
+        ftime_sum += (n - i) * (int32_t)ts_metrics[i];
     }
 
     /* Compute the mean of the cumulative sum */
-    ftime_mean = (float)ftime_sum / (float)(2 * ts_metrics_nb_clipped);
+    ftime_mean = (float)ftime_sum / (float)n;
 
-    /* Find the last timestamp_pps before packet to use as reference for ftime */
-    x = lgw_reg_rb(SX1302_REG_TIMESTAMP_TIMESTAMP_PPS_MSB2_TIMESTAMP_PPS , &buff[0], 4);
-    if (x != LGW_REG_SUCCESS) {
-        printf("ERROR: Failed to get timestamp counter value\n");
-        return 0;
-    }
-    timestamp_pps_reg  = (uint32_t)((buff[0] << 24) & 0xFF000000);
-    timestamp_pps_reg |= (uint32_t)((buff[1] << 16) & 0x00FF0000);
-    timestamp_pps_reg |= (uint32_t)((buff[2] << 8)  & 0x0000FF00);
-    timestamp_pps_reg |= (uint32_t)((buff[3] << 0)  & 0x000000FF);
-
-    /* Ensure that the timestamp PPS history is up-to-date */
-    timestamp_pps_history_save(timestamp_pps_reg);
+    /* The PPS counter read with the timestamp counter when the packets were fetched
+       (timestamp_counter_process()) is the last one saved in history */
+    timestamp_pps_reg = timestamp_pps_history.history[timestamp_pps_history.idx];
 
     /* Check if timestamp_pps_reg we just read is the reference to be used to compute ftime or not */
     if ((timestamp_cnt - timestamp_pps_reg) > 32e6) {
@@ -526,22 +763,12 @@ int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics
             printf("ERROR: failed to find the reference timestamp_pps, cannot compute ftime\n");
             return -1;
         }
-
-        /* Calculate the Xtal error between the reference PPS we just found and the next one */
-        timestamp_pps_idx_next = (timestamp_pps_idx == (MAX_TIMESTAMP_PPS_HISTORY - 1)) ? 0 : timestamp_pps_idx + 1;
-        diff_pps = timestamp_pps_history.history[timestamp_pps_idx_next] - timestamp_pps_history.history[timestamp_pps_idx];
-        xtal_correct = (double)32e6 / (double)(diff_pps);
     } else {
         /* The timestamp_pps_reg we just read is the reference we use to calculate the fine timestamp */
         timestamp_pps = timestamp_pps_reg;
         DEBUG_PRINTF("==> timestamp_pps => %u\n", timestamp_pps);
-
-        /* Calculate the Xtal error between the reference PPS we just found and the previous one */
-        timestamp_pps_idx = timestamp_pps_history.idx;
-        timestamp_pps_idx_prev = (timestamp_pps_idx == 0) ? (MAX_TIMESTAMP_PPS_HISTORY - 1) : (timestamp_pps_idx - 1);
-        diff_pps = timestamp_pps_history.history[timestamp_pps_idx] - timestamp_pps_history.history[timestamp_pps_idx_prev];
-        xtal_correct = (double)32e6 / (double)(diff_pps);
     }
+    DEBUG_PRINTF("xtal_correct : %.15lf (+/- %.4f ppm)\n", xtal_correct, xtal_sigma_ppm);
 
     /* Sanity Check on xtal_correct */
     if ((xtal_correct > 1.2) || (xtal_correct < 0.8)) {
@@ -561,12 +788,12 @@ int precise_timestamp_calculate(uint8_t ts_metrics_nb, const int8_t * ts_metrics
     DEBUG_PRINTF("pkt_ftime = %f\n", pkt_ftime);
 
     /* Add the DC notch filtering delay if necessary */
-    pkt_ftime += sx1302_dc_notch_delay((double)if_freq_hz / 1E3);
+    pkt_ftime += dc_notch_delay;
 
     /* Convert fine timestamp from 32 Mhz clock to nanoseconds */
     pkt_ftime *= 31.25;
 
-    /* Apply current XTAL error correction */
+    /* Apply XTAL error correction, filtered over the PPS seen so far */
     pkt_ftime *= xtal_correct;
 
     *result_ftime = (uint32_t)pkt_ftime;
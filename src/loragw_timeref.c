@@ -0,0 +1,365 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2019 Semtech
+
+Description:
+    Time correlation between the concentrator counter, the host clocks and GPS time.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#if __STDC_VERSION__ >= 199901L
+    #define _XOPEN_SOURCE 600
+#else
+    #define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* boolean type */
+#include <stdio.h>      /* printf fprintf */
+#include <string.h>     /* memset */
+#include <inttypes.h>   /* PRIu64 */
+#include <math.h>       /* fabs, llround */
+#include <time.h>       /* clock_gettime */
+
+#include "loragw_timeref.h"
+#include "loragw_hal.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#if DEBUG_TIMEREF == 1
+    #define DEBUG_MSG(str)                fprintf(stdout, str)
+    #define DEBUG_PRINTF(fmt, args...)    fprintf(stdout,"%s:%d: "fmt, __FUNCTION__, __LINE__, args)
+    #define CHECK_NULL(a)                if(a==NULL){fprintf(stderr,"%s:%d: ERROR: NULL POINTER AS ARGUMENT\n", __FUNCTION__, __LINE__);return LGW_HAL_ERROR;}
+#else
+    #define DEBUG_MSG(str)
+    #define DEBUG_PRINTF(fmt, args...)
+    #define CHECK_NULL(a)                if(a==NULL){return LGW_HAL_ERROR;}
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define TIMEREF_CNT_RESOLUTION_US   1.0         /* counter resolution, error of a single PPS latch */
+#define TIMEREF_XTAL_TOL            100e-6      /* counter rate tolerance, before any fit */
+#define TIMEREF_RATE_WANDER         0.01e-6     /* counter rate change over the fit window (temperature) */
+#define TIMEREF_HOST_RATE_TOL       50e-6       /* host clock rate error against GPS time */
+#define TIMEREF_ON_GPS_LEAD_US      20000       /* time needed to send a packet to the concentrator before the PPS */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+/**
+Fits the counter against GPS time over the PPS of the reference, by least squares
+*/
+static void timeref_fit(struct lgw_timeref_s * ref);
+
+/**
+Gets the counter rate against true time and its error bound: from the fit when there is one,
+else from the crystal correction tracked by the HAL, else nominal
+*/
+static void timeref_rate(const struct lgw_timeref_s * ref, double * rate, double * rate_err);
+
+/**
+Gets the counter and the host time at the same instant, with the error bound of the counter
+*/
+static int timeref_host_now(bool realtime, uint64_t * host_us, uint64_t * cnt_us, uint32_t * err_us);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void timeref_fit(struct lgw_timeref_s * ref) {
+    int i, k;
+    double x, y;
+    double mean_x = 0.0, mean_y = 0.0;
+    double sxx = 0.0, sxy = 0.0;
+    double res, res_max = 0.0;
+    double span = 0.0;
+    double xtal_rate, xtal_rate_err;
+
+    /* Origin of the fit on the last PPS, to keep the doubles small */
+    i = (ref->idx + LGW_TIMEREF_PPS_NB - 1) % LGW_TIMEREF_PPS_NB;
+    ref->cnt_ref = ref->cnt_us[i];
+    ref->gps_ref = ref->gps_us[i];
+
+    /* The drift tracked by the HAL over all the PPS seen is the only one with a single PPS */
+    timeref_rate(NULL, &xtal_rate, &xtal_rate_err);
+    if (ref->size < 2) {
+        ref->offset = 0.0;
+        ref->rate = xtal_rate;
+        ref->offset_err = TIMEREF_CNT_RESOLUTION_US;
+        ref->rate_err = xtal_rate_err;
+        return;
+    }
+
+    for (k = 0; k < ref->size; k++) {
+        i = (ref->idx + LGW_TIMEREF_PPS_NB - ref->size + k) % LGW_TIMEREF_PPS_NB;
+        x = (double)(int64_t)(ref->gps_us[i] - ref->gps_ref);
+        mean_x += x;
+        mean_y += (double)(int64_t)(ref->cnt_us[i] - ref->cnt_ref);
+        if (-x > span) {
+            span = -x;
+        }
+    }
+    mean_x /= ref->size;
+    mean_y /= ref->size;
+    for (k = 0; k < ref->size; k++) {
+        i = (ref->idx + LGW_TIMEREF_PPS_NB - ref->size + k) % LGW_TIMEREF_PPS_NB;
+        x = (double)(int64_t)(ref->gps_us[i] - ref->gps_ref) - mean_x;
+        y = (double)(int64_t)(ref->cnt_us[i] - ref->cnt_ref) - mean_y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    ref->rate = sxy / sxx;
+    ref->rate_err = 2.0 * TIMEREF_CNT_RESOLUTION_US / span + TIMEREF_RATE_WANDER;
+
+    /* Over a short window, the drift filtered by the HAL over all the PPS is the better one */
+    if (xtal_rate_err < ref->rate_err) {
+        ref->rate = xtal_rate;
+        ref->rate_err = xtal_rate_err;
+    }
+    ref->offset = mean_y - ref->rate * mean_x;
+
+    /* Error bounds from the worst residual, spread over the span of the fit for the rate */
+    for (k = 0; k < ref->size; k++) {
+        i = (ref->idx + LGW_TIMEREF_PPS_NB - ref->size + k) % LGW_TIMEREF_PPS_NB;
+        x = (double)(int64_t)(ref->gps_us[i] - ref->gps_ref);
+        y = (double)(int64_t)(ref->cnt_us[i] - ref->cnt_ref);
+        res = fabs(y - (ref->offset + ref->rate * x));
+        if (res > res_max) {
+            res_max = res;
+        }
+    }
+    ref->offset_err = res_max + TIMEREF_CNT_RESOLUTION_US;
+    ref->rate_err += 2.0 * res_max / span;
+
+    DEBUG_PRINTF("INFO: counter drift %.3f ppm +/- %.3f ppm, offset error %.1f us over %u PPS\n", (ref->rate - 1.0) * 1E6, ref->rate_err * 1E6, ref->offset_err, ref->size);
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static void timeref_rate(const struct lgw_timeref_s * ref, double * rate, double * rate_err) {
+    double xtal_correct, sigma_ppm;
+
+    if ((ref != NULL) && (ref->size > 0)) {
+        *rate = ref->rate;
+        *rate_err = ref->rate_err;
+    } else if (lgw_get_xtal_correct(&xtal_correct, &sigma_ppm) == LGW_HAL_SUCCESS) {
+        /* Correction is true time / counter time, bound at 3 sigma */
+        *rate = 1.0 / xtal_correct;
+        *rate_err = 3.0 * sigma_ppm * 1E-6 + TIMEREF_RATE_WANDER;
+    } else {
+        *rate = 1.0;
+        *rate_err = TIMEREF_XTAL_TOL;
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+static int timeref_host_now(bool realtime, uint64_t * host_us, uint64_t * cnt_us, uint32_t * err_us) {
+    struct timespec now;
+
+    /* The counter is extrapolated from the host clock, reading it right after keeps both close */
+    if (lgw_get_instcnt_estimate(LGW_INSTCNT_ERROR_MAX, cnt_us, err_us) != LGW_HAL_SUCCESS) {
+        printf("ERROR: failed to get concentrator counter\n");
+        return LGW_HAL_ERROR;
+    }
+    clock_gettime((realtime == true) ? CLOCK_REALTIME : CLOCK_MONOTONIC, &now);
+    *host_us = (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void lgw_timeref_reset(struct lgw_timeref_s * ref) {
+    if (ref != NULL) {
+        memset(ref, 0, sizeof(*ref));
+    }
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_timeref_sync(struct lgw_timeref_s * ref, uint64_t trig_cnt_us, uint64_t gps_us) {
+    int last;
+    bool consistent = true;
+    double d_gps, d_cnt;
+
+    CHECK_NULL(ref);
+
+    /* The counter must go forward at the rate of GPS time, within crystal tolerance */
+    if (ref->size > 0) {
+        last = (ref->idx + LGW_TIMEREF_PPS_NB - 1) % LGW_TIMEREF_PPS_NB;
+        if ((trig_cnt_us == ref->cnt_us[last]) && (gps_us == ref->gps_us[last])) {
+            return LGW_HAL_SUCCESS;
+        }
+        if ((trig_cnt_us <= ref->cnt_us[last]) || (gps_us <= ref->gps_us[last])) {
+            consistent = false;
+        } else {
+            d_gps = (double)(gps_us - ref->gps_us[last]);
+            d_cnt = (double)(trig_cnt_us - ref->cnt_us[last]);
+            if (fabs(d_cnt - d_gps) > (d_gps * TIMEREF_XTAL_TOL + 2 * TIMEREF_CNT_RESOLUTION_US)) {
+                consistent = false;
+            }
+        }
+        if (consistent == false) {
+            printf("WARNING: PPS at counter %" PRIu64 " us / GPS %" PRIu64 " us not consistent with the previous one, restarting time reference\n", trig_cnt_us, gps_us);
+            lgw_timeref_reset(ref);
+        }
+    }
+
+    ref->cnt_us[ref->idx] = trig_cnt_us;
+    ref->gps_us[ref->idx] = gps_us;
+    ref->idx = (ref->idx + 1) % LGW_TIMEREF_PPS_NB;
+    if (ref->size < LGW_TIMEREF_PPS_NB) {
+        ref->size += 1;
+    }
+    timeref_fit(ref);
+
+    return (consistent == true) ? LGW_HAL_SUCCESS : LGW_HAL_ERROR;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_cnt2gps(const struct lgw_timeref_s * ref, uint64_t count_us, uint64_t * gps_us, uint32_t * err_us) {
+    double d_gps;
+
+    CHECK_NULL(ref);
+    CHECK_NULL(gps_us);
+    CHECK_NULL(err_us);
+
+    if (ref->size == 0) {
+        printf("ERROR: time reference has no PPS\n");
+        return LGW_HAL_ERROR;
+    }
+
+    d_gps = ((double)(int64_t)(count_us - ref->cnt_ref) - ref->offset) / ref->rate;
+    *gps_us = ref->gps_ref + (uint64_t)llround(d_gps);
+    *err_us = (uint32_t)(ref->offset_err + fabs(d_gps) * ref->rate_err) + 1;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gps2cnt(const struct lgw_timeref_s * ref, uint64_t gps_us, uint64_t * count_us, uint32_t * err_us) {
+    double d_gps;
+
+    CHECK_NULL(ref);
+    CHECK_NULL(count_us);
+    CHECK_NULL(err_us);
+
+    if (ref->size == 0) {
+        printf("ERROR: time reference has no PPS\n");
+        return LGW_HAL_ERROR;
+    }
+
+    d_gps = (double)(int64_t)(gps_us - ref->gps_ref);
+    *count_us = ref->cnt_ref + (uint64_t)llround(ref->offset + d_gps * ref->rate);
+    *err_us = (uint32_t)(ref->offset_err + fabs(d_gps) * ref->rate_err) + 1;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_cnt2host(const struct lgw_timeref_s * ref, bool realtime, uint64_t count_us, uint64_t * host_us, uint32_t * err_us) {
+    uint64_t host_now, cnt_now;
+    uint32_t err_now;
+    double rate, rate_err;
+    double d_host;
+
+    CHECK_NULL(host_us);
+    CHECK_NULL(err_us);
+
+    if (timeref_host_now(realtime, &host_now, &cnt_now, &err_now) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    timeref_rate(ref, &rate, &rate_err);
+    rate_err += TIMEREF_HOST_RATE_TOL;
+
+    d_host = (double)(int64_t)(count_us - cnt_now) / rate;
+    *host_us = host_now + (uint64_t)llround(d_host);
+    *err_us = err_now + (uint32_t)(fabs(d_host) * rate_err) + 1;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_host2cnt(const struct lgw_timeref_s * ref, bool realtime, uint64_t host_us, uint64_t * count_us, uint32_t * err_us) {
+    uint64_t host_now, cnt_now;
+    uint32_t err_now;
+    double rate, rate_err;
+    double d_host;
+
+    CHECK_NULL(count_us);
+    CHECK_NULL(err_us);
+
+    if (timeref_host_now(realtime, &host_now, &cnt_now, &err_now) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    timeref_rate(ref, &rate, &rate_err);
+    rate_err += TIMEREF_HOST_RATE_TOL;
+
+    d_host = (double)(int64_t)(host_us - host_now);
+    *count_us = cnt_now + (uint64_t)llround(d_host * rate);
+    *err_us = err_now + (uint32_t)(fabs(d_host) * rate_err) + 1;
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
+
+int lgw_gps2tx(const struct lgw_timeref_s * ref, uint64_t gps_us, struct lgw_pkt_tx_s * pkt_data) {
+    uint64_t cnt_us, gps_now;
+    uint32_t err_us, err_now;
+
+    CHECK_NULL(ref);
+    CHECK_NULL(pkt_data);
+
+    if (pkt_data->tx_mode == ON_GPS) {
+        if ((gps_us % 1000000) != 0) {
+            printf("ERROR: ON_GPS TX time %" PRIu64 " us is not on a PPS\n", gps_us);
+            return LGW_HAL_ERROR;
+        }
+        if (lgw_get_instcnt_estimate(LGW_INSTCNT_ERROR_MAX, &cnt_us, &err_now) != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+        if (lgw_cnt2gps(ref, cnt_us, &gps_now, &err_us) != LGW_HAL_SUCCESS) {
+            return LGW_HAL_ERROR;
+        }
+        err_us += err_now;
+
+        /* The PPS before gps_us must be over, and there must be time left to send the packet */
+        if (((gps_now + 1000000) < (gps_us + err_us)) || ((gps_now + err_us + TIMEREF_ON_GPS_LEAD_US) > gps_us)) {
+            printf("ERROR: ON_GPS TX time %" PRIu64 " us is not the next PPS (now %" PRIu64 " us +/- %u us)\n", gps_us, gps_now, err_us);
+            return LGW_HAL_ERROR;
+        }
+        return LGW_HAL_SUCCESS;
+    }
+
+    if (lgw_gps2cnt(ref, gps_us, &cnt_us, &err_us) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    if (lgw_time64_to_count_us(cnt_us, &pkt_data->count_us) != LGW_HAL_SUCCESS) {
+        return LGW_HAL_ERROR;
+    }
+    pkt_data->tx_mode = TIMESTAMPED;
+    DEBUG_PRINTF("INFO: GPS time %" PRIu64 " us scheduled at count_us %u (+/- %u us)\n", gps_us, pkt_data->count_us, err_us);
+
+    return LGW_HAL_SUCCESS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */